@@ -1,8 +1,10 @@
-LIBPARATEC_1.0 {
+LIBPARATEC_2.0 {
 	global:
 		main;
 		pt_*;
 		_pt_*;
+		__cyg_profile_func_enter;
+		__cyg_profile_func_exit;
 		extern "C++" {
 			*std::equal_to*;
 			*pt::assert::*;
@@ -0,0 +1,526 @@
+/**
+ * @author Andrew Stone <a@stoney.io>
+ * @copyright 2016 Andrew Stone
+ *
+ * This file is part of paratec and is released under the MIT License:
+ * http://opensource.org/licenses/MIT
+ */
+
+/**
+ * The allocation tracker behind --leaks. It replaces the process's allocator,
+ * so it's never linked into libparatec: it's only ever preloaded into the
+ * binaries that run forked tests with --leaks, and anything else is left with
+ * whatever allocator (or sanitizer) it was built with.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <errno.h>
+#include <execinfo.h>
+#include <map>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/mman.h>
+#include <vector>
+
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t n, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+void *__libc_memalign(size_t align, size_t size);
+void *__libc_valloc(size_t size);
+void *__libc_pvalloc(size_t size);
+void __libc_free(void *ptr);
+}
+
+namespace pt
+{
+namespace leaks
+{
+
+/**
+ * Most live allocations that can be tracked: past this, allocations stop
+ * being tracked, and whatever leaks from them goes unnoticed.
+ */
+static constexpr size_t kSlots = 1 << 20;
+
+/**
+ * Most distinct places allocations can come from
+ */
+static constexpr size_t kSites = 1 << 14;
+static constexpr uint32_t kNoSite = UINT32_MAX;
+
+/**
+ * Frames of each allocation's stack to remember, and how many to skip: the
+ * tracking itself and the allocation function.
+ */
+static constexpr int kFrames = 8;
+static constexpr int kSkipFrames = 2;
+
+/**
+ * Most allocation sites to describe
+ */
+static constexpr size_t kMaxReported = 8;
+
+struct _Site {
+	int nframes_;
+	void *frames_[kFrames];
+};
+
+struct _Alloc {
+	/**
+	 * 0 for an empty slot
+	 */
+	uintptr_t ptr_;
+	size_t size_;
+	uint32_t site_;
+};
+
+/**
+ * Never freed: tracking lasts until the test exits. Both are mapped rather
+ * than allocated so that tracking never allocates.
+ */
+static _Alloc *_allocs;
+static _Site *_sites;
+
+static size_t _nallocs;
+static size_t _nsites;
+static bool _overflowed;
+
+static std::atomic<bool> _tracking{ false };
+static std::atomic_flag _lock = ATOMIC_FLAG_INIT;
+
+/**
+ * Getting a backtrace can allocate
+ */
+static __thread bool _inHook __attribute__((tls_model("initial-exec")));
+
+class _Locked
+{
+public:
+	_Locked()
+	{
+		while (_lock.test_and_set(std::memory_order_acquire)) {
+		}
+	}
+
+	~_Locked()
+	{
+		_lock.clear(std::memory_order_release);
+	}
+};
+
+static inline size_t _home(uintptr_t ptr)
+{
+	return (size_t)(((ptr >> 4) * 0x9e3779b97f4a7c15) >> (64 - 20));
+}
+
+static uint32_t _site(const _Site &s)
+{
+	int i;
+	size_t probe;
+	uintptr_t h = 0;
+
+	for (i = 0; i < s.nframes_; i++) {
+		h = (h ^ (uintptr_t)s.frames_[i]) * 0x100000001b3;
+	}
+
+	for (probe = 0; probe < kSites; probe++) {
+		auto idx = (h + probe) % kSites;
+		auto &site = _sites[idx];
+
+		if (site.nframes_ == 0) {
+			if (_nsites >= kSites / 4 * 3) {
+				return kNoSite;
+			}
+
+			site = s;
+			_nsites++;
+			return (uint32_t)idx;
+		}
+
+		if (site.nframes_ == s.nframes_
+			&& memcmp(site.frames_, s.frames_,
+					  sizeof(s.frames_[0]) * s.nframes_)
+				   == 0) {
+			return (uint32_t)idx;
+		}
+	}
+
+	return kNoSite;
+}
+
+static void _insert(uintptr_t ptr, size_t size, uint32_t site)
+{
+	auto i = _home(ptr);
+
+	if (_nallocs >= kSlots / 4 * 3) {
+		_overflowed = true;
+		return;
+	}
+
+	while (_allocs[i].ptr_ != 0) {
+		i = (i + 1) % kSlots;
+	}
+
+	_allocs[i] = { ptr, size, site };
+	_nallocs++;
+}
+
+/**
+ * Linear probing with backward-shift deletion, so that a test that allocates
+ * and frees forever never leaves behind anything to probe past.
+ */
+static bool _remove(uintptr_t ptr, _Alloc *removed)
+{
+	size_t i = _home(ptr);
+
+	while (_allocs[i].ptr_ != ptr) {
+		if (_allocs[i].ptr_ == 0) {
+			return false;
+		}
+
+		i = (i + 1) % kSlots;
+	}
+
+	*removed = _allocs[i];
+
+	auto j = i;
+	while (true) {
+		j = (j + 1) % kSlots;
+		if (_allocs[j].ptr_ == 0) {
+			break;
+		}
+
+		// Entries that are already as close to home as they can get stay put
+		auto k = _home(_allocs[j].ptr_);
+		if (i <= j ? (i < k && k <= j) : (i < k || k <= j)) {
+			continue;
+		}
+
+		_allocs[i] = _allocs[j];
+		i = j;
+	}
+
+	_allocs[i].ptr_ = 0;
+	_nallocs--;
+
+	return true;
+}
+
+static __attribute__((noinline)) void _track(void *ptr, size_t size)
+{
+	if (ptr == nullptr || !_tracking.load(std::memory_order_relaxed)
+		|| _inHook) {
+		return;
+	}
+
+	_Site s;
+
+	_inHook = true;
+	s.nframes_ = backtrace(s.frames_, kFrames);
+	_inHook = false;
+
+	// Drop the tracking from the stack
+	auto skip = std::min(s.nframes_, kSkipFrames);
+	memmove(s.frames_, s.frames_ + skip, sizeof(s.frames_[0]) * (kFrames - skip));
+	s.nframes_ -= skip;
+
+	_Locked l;
+	_insert((uintptr_t)ptr, size, s.nframes_ > 0 ? _site(s) : kNoSite);
+}
+
+static bool _untrack(void *ptr, _Alloc *removed)
+{
+	if (ptr == nullptr || !_tracking.load(std::memory_order_relaxed)) {
+		return false;
+	}
+
+	_Locked l;
+	return _remove((uintptr_t)ptr, removed);
+}
+
+static void *_map(size_t size)
+{
+	auto p = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+				  MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+
+	return p == MAP_FAILED ? nullptr : p;
+}
+
+static std::string _frame(void *addr)
+{
+	Dl_info info;
+	char buff[64];
+
+	if (dladdr(addr, &info) == 0) {
+		snprintf(buff, sizeof(buff), "%p", addr);
+		return buff;
+	}
+
+	// Static functions have no symbols; offsets are what addr2line wants
+	if (info.dli_sname == nullptr) {
+		snprintf(buff, sizeof(buff), "+0x%zx",
+				 (size_t)((uintptr_t)addr - (uintptr_t)info.dli_fbase));
+		return std::string(info.dli_fname) + buff;
+	}
+
+	int status;
+	std::string name = info.dli_sname;
+	auto demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr,
+										 &status);
+	if (demangled != nullptr) {
+		name = demangled;
+		free(demangled);
+	}
+
+	snprintf(buff, sizeof(buff), "+0x%zx",
+			 (size_t)((uintptr_t)addr - (uintptr_t)info.dli_saddr));
+
+	return name + buff;
+}
+
+/**
+ * Inlined so that both realloc() and reallocarray() are one frame from
+ * tracking, like every other allocation function.
+ */
+static inline __attribute__((always_inline)) void *_realloc(void *ptr,
+															size_t size)
+{
+	_Alloc old;
+	auto tracked = _untrack(ptr, &old);
+
+	auto p = __libc_realloc(ptr, size);
+	if (p == nullptr && size != 0 && tracked) {
+		// The original is still around
+		_Locked l;
+		_insert(old.ptr_, old.size_, old.site_);
+	}
+
+	_track(p, size);
+	return p;
+}
+
+static bool _start()
+{
+	// Standard streams allocate their buffers the first time they're written
+	// to, which would look like a leak in every test that prints anything.
+	static char out[BUFSIZ];
+	static char err[BUFSIZ];
+	setvbuf(stdout, out, _IOLBF, sizeof(out));
+	setvbuf(stderr, err, _IOLBF, sizeof(err));
+
+	// The first backtrace loads the unwinder, which allocates
+	void *frame;
+	backtrace(&frame, 1);
+
+	_allocs = (_Alloc *)_map(sizeof(*_allocs) * kSlots);
+	_sites = (_Site *)_map(sizeof(*_sites) * kSites);
+	if (_allocs == nullptr || _sites == nullptr) {
+		return false;
+	}
+
+	_tracking = true;
+
+	return true;
+}
+
+static bool _check(std::string *msg)
+{
+	struct Leak {
+		uint32_t site_;
+		size_t bytes_;
+		size_t count_;
+	};
+
+	size_t i;
+	size_t bytes = 0;
+	size_t count = 0;
+	std::map<uint32_t, Leak> by_site;
+
+	{
+		_Locked l;
+		_tracking = false;
+
+		for (i = 0; i < kSlots; i++) {
+			const auto &a = _allocs[i];
+
+			if (a.ptr_ != 0) {
+				auto &leak = by_site[a.site_];
+				leak.site_ = a.site_;
+				leak.bytes_ += a.size_;
+				leak.count_++;
+				bytes += a.size_;
+				count++;
+			}
+		}
+	}
+
+	if (count == 0) {
+		return false;
+	}
+
+	std::vector<Leak> leaks;
+	for (const auto &l : by_site) {
+		leaks.push_back(l.second);
+	}
+
+	std::sort(leaks.begin(), leaks.end(), [](const Leak &a, const Leak &b) {
+		return a.bytes_ > b.bytes_;
+	});
+
+	char buff[128];
+	snprintf(buff, sizeof(buff), "leaked %zu bytes in %zu allocations%s",
+			 bytes, count,
+			 _overflowed ? " (too many live allocations to track them all)"
+						 : "");
+	*msg = buff;
+
+	for (i = 0; i < std::min(leaks.size(), kMaxReported); i++) {
+		const auto &leak = leaks[i];
+
+		snprintf(buff, sizeof(buff), "\n  %zu bytes in %zu allocations from:",
+				 leak.bytes_, leak.count_);
+		*msg += buff;
+
+		if (leak.site_ == kNoSite) {
+			*msg += "\n    (unknown)";
+			continue;
+		}
+
+		const auto &site = _sites[leak.site_];
+		for (int f = 0; f < site.nframes_; f++) {
+			*msg += "\n    " + _frame(site.frames_[f]);
+		}
+	}
+
+	if (leaks.size() > kMaxReported) {
+		snprintf(buff, sizeof(buff), "\n  ... and %zu more sites",
+				 leaks.size() - kMaxReported);
+		*msg += buff;
+	}
+
+	return true;
+}
+}
+}
+
+/**
+ * Every allocation in the process goes through here. Until a test starts
+ * tracking, these just pass through to libc.
+ */
+extern "C" {
+
+/**
+ * Start tracking every allocation made in this process. Returns 0, or -1 if
+ * there's no memory to track anything in.
+ */
+int pt_leaks_start(void)
+{
+	return pt::leaks::_start() ? 0 : -1;
+}
+
+/**
+ * Stop tracking. If anything allocated since pt_leaks_start() is still around,
+ * returns a description of it, to be free()d.
+ */
+char *pt_leaks_check(void)
+{
+	std::string msg;
+
+	if (!pt::leaks::_check(&msg)) {
+		return nullptr;
+	}
+
+	return strdup(msg.c_str());
+}
+
+void *malloc(size_t size)
+{
+	auto p = __libc_malloc(size);
+	pt::leaks::_track(p, size);
+	return p;
+}
+
+void *calloc(size_t n, size_t size)
+{
+	auto p = __libc_calloc(n, size);
+	pt::leaks::_track(p, n * size);
+	return p;
+}
+
+void *realloc(void *ptr, size_t size)
+{
+	return pt::leaks::_realloc(ptr, size);
+}
+
+void *reallocarray(void *ptr, size_t n, size_t size)
+{
+	size_t total;
+
+	if (__builtin_mul_overflow(n, size, &total)) {
+		errno = ENOMEM;
+		return nullptr;
+	}
+
+	return pt::leaks::_realloc(ptr, total);
+}
+
+void *memalign(size_t align, size_t size)
+{
+	auto p = __libc_memalign(align, size);
+	pt::leaks::_track(p, size);
+	return p;
+}
+
+void *aligned_alloc(size_t align, size_t size)
+{
+	auto p = __libc_memalign(align, size);
+	pt::leaks::_track(p, size);
+	return p;
+}
+
+int posix_memalign(void **ptr, size_t align, size_t size)
+{
+	if (align % sizeof(void *) != 0 || (align & (align - 1)) != 0) {
+		return EINVAL;
+	}
+
+	auto p = __libc_memalign(align, size);
+	if (p == nullptr) {
+		return ENOMEM;
+	}
+
+	pt::leaks::_track(p, size);
+	*ptr = p;
+
+	return 0;
+}
+
+void *valloc(size_t size)
+{
+	auto p = __libc_valloc(size);
+	pt::leaks::_track(p, size);
+	return p;
+}
+
+void *pvalloc(size_t size)
+{
+	auto p = __libc_pvalloc(size);
+	pt::leaks::_track(p, size);
+	return p;
+}
+
+void free(void *ptr)
+{
+	pt::leaks::_Alloc old;
+	pt::leaks::_untrack(ptr, &old);
+	__libc_free(ptr);
+}
+}
+
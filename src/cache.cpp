@@ -0,0 +1,244 @@
+/**
+ * @author Andrew Stone <a@stoney.io>
+ * @copyright 2016 Andrew Stone
+ *
+ * This file is part of paratec and is released under the MIT License:
+ * http://opensource.org/licenses/MIT
+ */
+
+#include <errno.h>
+#include <fstream>
+#include <inttypes.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "cache.hpp"
+#include "err.hpp"
+
+#ifdef PT_LINUX
+#include <link.h>
+#endif
+
+namespace pt
+{
+
+/**
+ * 64-bit FNV-1a: nothing here needs to stand up to anyone trying to collide
+ * it, it just has to notice when a file changes.
+ */
+class _Hash
+{
+	static constexpr uint64_t kPrime = 0x100000001b3;
+
+	uint64_t h_;
+
+public:
+	_Hash(uint64_t seed = 0xcbf29ce484222325) : h_(seed)
+	{
+	}
+
+	inline uint64_t get() const
+	{
+		return this->h_;
+	}
+
+	void bytes(const void *data, size_t len)
+	{
+		auto b = (const uint8_t *)data;
+		auto end = b + len;
+
+		for (; b < end; b++) {
+			this->h_ = (this->h_ ^ *b) * kPrime;
+		}
+	}
+
+	/**
+	 * Hash a string along with its length, so that "ab","c" and "a","bc"
+	 * hash differently.
+	 */
+	void str(const std::string &s)
+	{
+		uint64_t len = s.size();
+		this->bytes(&len, sizeof(len));
+		this->bytes(s.data(), s.size());
+	}
+
+	/**
+	 * Hash the contents of the file. Missing files hash differently than
+	 * empty ones.
+	 */
+	void file(const std::string &path)
+	{
+		char buff[64 * 1024];
+		FILE *f = fopen(path.c_str(), "rb");
+
+		this->str(path);
+
+		if (f == nullptr) {
+			this->str("\x01missing");
+			return;
+		}
+
+		while (true) {
+			auto n = fread(buff, 1, sizeof(buff), f);
+			if (n == 0) {
+				break;
+			}
+
+			this->bytes(buff, n);
+		}
+
+		fclose(f);
+	}
+};
+
+#ifdef PT_LINUX
+
+/**
+ * Every shared object loaded into this process, in load order. The binary
+ * itself has no name.
+ */
+static std::vector<std::string> _objects()
+{
+	std::vector<std::string> objs;
+
+	dl_iterate_phdr(
+		[](struct dl_phdr_info *info, size_t, void *data) {
+			if (info->dlpi_name != nullptr && info->dlpi_name[0] != '\0') {
+				((std::vector<std::string> *)data)->push_back(info->dlpi_name);
+			}
+
+			return 0;
+		},
+		&objs);
+
+	return objs;
+}
+
+#endif
+
+Cache::Cache(std::string dir, const Opts &opts) : dir_(std::move(dir))
+{
+	int err;
+	_Hash h;
+
+	err = mkdir(this->dir_.c_str(), 0755);
+	OSErr(err, { EEXIST }, "failed to create cache directory %s",
+		  this->dir_.c_str());
+
+#ifdef PT_LINUX
+	h.file("/proc/self/exe");
+
+	// A test's code is just as much in the libraries it links against
+	for (const auto &so : _objects()) {
+		h.file(so);
+	}
+#else
+	h.file(opts.bin_name_);
+#endif
+
+	for (const auto &so : opts.load_.get()) {
+		h.file(so);
+	}
+
+	// Benchmarks are never cached, so only the options that change how
+	// tests run matter. The limits are part of each test's own key.
+	h.str(std::to_string(opts.timeout_.get()));
+	h.str(std::to_string(opts.verbose_.passedOutput()));
+	h.str(std::to_string(opts.leaks_.get()));
+	h.str(std::to_string(opts.cgroup_.get()));
+	h.str(std::to_string(opts.pin_.get()));
+
+	this->cgroup_ = opts.cgroup_.get();
+
+	this->base_ = h.get();
+}
+
+uint64_t Cache::binHash(const std::string &path) const
+{
+	auto it = this->bins_.find(path);
+	if (it != this->bins_.end()) {
+		return it->second;
+	}
+
+	_Hash h;
+	h.file(path);
+
+	this->bins_[path] = h.get();
+	return h.get();
+}
+
+std::string Cache::path(const Test &test) const
+{
+	char buff[32];
+	_Hash h(this->base_);
+
+	h.str(test.name());
+
+	// Limits only apply in a cgroup
+	if (this->cgroup_) {
+		h.str(std::to_string(test.memoryMax()));
+		h.str(std::to_string(test.cpuMax()));
+		h.str(std::to_string(test.pidsMax()));
+	}
+
+	if (test.remote() != nullptr) {
+		auto bin = this->binHash(test.remote()->bin_);
+		h.bytes(&bin, sizeof(bin));
+	}
+
+	for (const auto &in : test.inputs()) {
+		if (in.size() > 0) {
+			h.file(in);
+		}
+	}
+
+	snprintf(buff, sizeof(buff), "%016" PRIx64, h.get());
+
+	return this->dir_ + "/" + buff;
+}
+
+bool Cache::get(const Test &test, Result *r) const
+{
+	auto path = this->path(test);
+
+	if (access(path.c_str(), F_OK) != 0) {
+		return false;
+	}
+
+	// A cache entry that can't be read is as good as no entry
+	try {
+		auto rs = Results::load(path);
+		if (rs.size() != 1 || rs[0].test_name_ != test.name()) {
+			return false;
+		}
+
+		r->replaceWith(std::move(rs[0]));
+	} catch (const Err &) {
+		return false;
+	}
+
+	r->cached_ = true;
+
+	return true;
+}
+
+void Cache::put(const Test &test, const Result &r) const
+{
+	int err;
+
+	if (!r.passed() || r.bench_ || r.skipped_) {
+		return;
+	}
+
+	auto path = this->path(test);
+	auto tmp = path + ".tmp." + std::to_string(getpid());
+
+	Results::save(tmp, { r }, r.duration_);
+
+	// Other runs might be sharing the cache: never let them see a partial
+	// entry.
+	err = rename(tmp.c_str(), path.c_str());
+	OSErr(err, {}, "failed to write cache entry %s", path.c_str());
+}
+}
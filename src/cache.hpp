@@ -0,0 +1,66 @@
+/**
+ * @file
+ * @author Andrew Stone <a@stoney.io>
+ * @copyright 2016 Andrew Stone
+ *
+ * This file is part of paratec and is released under the MIT License:
+ * http://opensource.org/licenses/MIT
+ */
+
+#pragma once
+#include <map>
+#include <string>
+#include "opts.hpp"
+#include "results.hpp"
+#include "std.hpp"
+#include "test.hpp"
+
+namespace pt
+{
+
+/**
+ * Remembers tests that passed, keyed by everything that could change their
+ * outcome: the binary they live in and the libraries it loaded, the files
+ * they read, and the options and limits they ran with. A test is only run
+ * again once any of those change.
+ */
+class Cache
+{
+	std::string dir_;
+
+	/**
+	 * Hash of everything every test shares
+	 */
+	uint64_t base_;
+
+	/**
+	 * If tests run in cgroups, where their limits apply
+	 */
+	bool cgroup_;
+
+	/**
+	 * Hashes of the binaries remote tests run in; each is only read once.
+	 */
+	mutable std::map<std::string, uint64_t> bins_;
+
+	uint64_t binHash(const std::string &path) const;
+
+	/**
+	 * Where the test's result is kept
+	 */
+	std::string path(const Test &test) const;
+
+public:
+	Cache(std::string dir, const Opts &opts);
+
+	/**
+	 * Get the test's cached result. Returns false if there isn't one.
+	 */
+	bool get(const Test &test, Result *r) const;
+
+	/**
+	 * Cache the test's result, if it passed
+	 */
+	void put(const Test &test, const Result &r) const;
+};
+}
@@ -0,0 +1,143 @@
+/**
+ * @author Andrew Stone <a@stoney.io>
+ * @copyright 2016 Andrew Stone
+ *
+ * This file is part of paratec and is released under the MIT License:
+ * http://opensource.org/licenses/MIT
+ */
+
+#include <dirent.h>
+#include <fstream>
+#include <unistd.h>
+#include "cache.hpp"
+#include "main.hpp"
+#include "util.hpp"
+#include "util_test.hpp"
+
+namespace pt
+{
+
+#define kInput "/tmp/paratec-cache-input"
+
+TEST(_cachePass)
+{
+}
+
+TEST(_cacheFail)
+{
+	pt_fail("never cached");
+}
+
+TEST(_cacheInput, PTINPUT(kInput))
+{
+}
+
+static Results _runCached(const char *dir, const char *timeout = "5")
+{
+	std::stringstream out;
+	std::string carg(std::string("--cache=") + dir);
+
+	Main m({ MKTEST(_cachePass), MKTEST(_cacheFail), MKTEST(_cacheInput) });
+	return m.run(out, { "paratec", carg.c_str(), "-t", timeout });
+}
+
+static void _rmCache(const char *dir)
+{
+	DIR *dh = opendir(dir);
+	struct dirent *ent;
+
+	while ((ent = readdir(dh)) != nullptr) {
+		unlink((std::string(dir) + "/" + ent->d_name).c_str());
+	}
+
+	closedir(dh);
+	rmdir(dir);
+}
+
+static void _writeInput(const char *contents)
+{
+	std::ofstream f(kInput, std::ios::trunc);
+	f << contents;
+}
+
+TEST(cacheReuse)
+{
+	char dir[] = "/tmp/paratec-cache-XXXXXX";
+	pt(mkdtemp(dir) != nullptr);
+
+	DTor d([&]() {
+		_rmCache(dir);
+		unlink(kInput);
+	});
+
+	_writeInput("a");
+
+	auto first = _runCached(dir);
+	pt(!first.get("_cachePass").cached_);
+	pt(!first.get("_cacheInput").cached_);
+
+	// Only passes are cached
+	auto second = _runCached(dir);
+	pt(second.get("_cachePass").cached_);
+	pt(second.get("_cacheInput").cached_);
+	pt(!second.get("_cacheFail").cached_);
+	pt(second.get("_cacheFail").failed_);
+	pt_eq(second.exitCode(), 1);
+
+	_writeInput("b");
+
+	auto third = _runCached(dir);
+	pt(third.get("_cachePass").cached_);
+	pt(!third.get("_cacheInput").cached_);
+
+	// Options that change how tests run invalidate everything
+	auto fourth = _runCached(dir, "4");
+	pt(!fourth.get("_cachePass").cached_);
+}
+
+TEST(cacheLeaks)
+{
+	char dir[] = "/tmp/paratec-cache-XXXXXX";
+	pt(mkdtemp(dir) != nullptr);
+
+	std::string carg(std::string("--cache=") + dir);
+	DTor d([&]() { _rmCache(dir); });
+
+	auto run = [&](bool leaks) {
+		std::stringstream out;
+		std::vector<const char *> args{ "paratec", carg.c_str() };
+		if (leaks) {
+			args.push_back("--leaks");
+		}
+
+		Main m({ MKTEST(_cachePass) });
+		return m.run(out, args).get("_cachePass").cached_;
+	};
+
+	pt(!run(false));
+	pt(!run(true));
+	pt(run(true));
+	pt(run(false));
+}
+
+TEST(cacheSummary)
+{
+	char dir[] = "/tmp/paratec-cache-XXXXXX";
+	pt(mkdtemp(dir) != nullptr);
+
+	std::string carg(std::string("--cache=") + dir);
+	DTor d([&]() { _rmCache(dir); });
+
+	for (int i = 0; i < 2; i++) {
+		std::stringstream out;
+
+		Main m({ MKTEST(_cachePass) });
+		m.run(out, { "paratec", carg.c_str(), "-v" });
+
+		if (i == 1) {
+			pt_in("1 OK (1 cached), 0 errors", out.str());
+			pt_in("PASS : _cachePass (cached)", out.str());
+		}
+	}
+}
+}
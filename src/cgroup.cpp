@@ -0,0 +1,353 @@
+/**
+ * @author Andrew Stone <a@stoney.io>
+ * @copyright 2016 Andrew Stone
+ *
+ * This file is part of paratec and is released under the MIT License:
+ * http://opensource.org/licenses/MIT
+ */
+
+#include <errno.h>
+#include <fstream>
+#include <signal.h>
+#include <sstream>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "cgroup.hpp"
+#include "err.hpp"
+
+namespace pt
+{
+
+/**
+ * Period to give cpu.max quotas over
+ */
+static constexpr uint64_t kCpuPeriodUsec = 100000;
+
+/**
+ * How long to wait, at the end of a run, for killed cgroups to empty out
+ */
+static constexpr int kDrainWaitMs = 1000;
+
+static std::string _read(const std::string &path)
+{
+	std::ifstream f(path);
+	std::stringstream ss;
+
+	ss << f.rdbuf();
+
+	return ss.str();
+}
+
+static bool _write(const std::string &path, const std::string &val)
+{
+	std::ofstream f(path);
+
+	// Writes to cgroup files fail when they're flushed
+	f << val;
+	f.flush();
+
+	return f.good();
+}
+
+/**
+ * Value of the given key in a flat-keyed file (eg. cpu.stat)
+ */
+static std::string _field(const std::string &contents, const std::string &key)
+{
+	std::string line;
+	std::istringstream is(contents);
+
+	while (std::getline(is, line)) {
+		if (line.compare(0, key.size() + 1, key + " ") == 0) {
+			return line.substr(key.size() + 1);
+		}
+	}
+
+	return "";
+}
+
+static std::string _v2Mount()
+{
+	std::string line;
+	std::ifstream f("/proc/self/mountinfo");
+
+	// Lines look like: `id parent maj:min root mount opts... - type src opts`
+	while (std::getline(f, line)) {
+		std::string field;
+		std::vector<std::string> fields;
+		std::istringstream is(line);
+
+		while (is >> field) {
+			fields.push_back(field);
+		}
+
+		for (size_t i = 0; i + 1 < fields.size(); i++) {
+			if (fields[i] == "-" && fields[i + 1] == "cgroup2"
+				&& fields.size() > 4) {
+				return fields[4];
+			}
+		}
+	}
+
+	return "";
+}
+
+static std::string _self()
+{
+	std::string line;
+	std::ifstream f("/proc/self/cgroup");
+
+	while (std::getline(f, line)) {
+		if (line.compare(0, 3, "0::") == 0) {
+			return line.substr(3);
+		}
+	}
+
+	return "";
+}
+
+Cgroup::Cgroup(std::string dir, const Limits &limits) : dir_(std::move(dir))
+{
+	int err = mkdir(this->dir_.c_str(), 0755);
+	OSErr(err, {}, "failed to create cgroup %s", this->dir_.c_str());
+
+	auto set = [&](const char *file, const std::string &val) {
+		if (!_write(this->dir_ + "/" + file, val)) {
+			OSErr(-1, {}, "failed to set %s of cgroup %s", file,
+				  this->dir_.c_str());
+		}
+	};
+
+	if (limits.memory_max_ > 0) {
+		set("memory.max", std::to_string(limits.memory_max_));
+	}
+
+	if (limits.cpu_max_ > 0) {
+		auto quota = (uint64_t)(limits.cpu_max_ * kCpuPeriodUsec);
+		set("cpu.max", std::to_string(std::max(quota, (uint64_t)1000)) + " "
+						   + std::to_string(kCpuPeriodUsec));
+	}
+
+	if (limits.pids_max_ > 0) {
+		set("pids.max", std::to_string(limits.pids_max_));
+	}
+}
+
+Cgroup::~Cgroup()
+{
+	this->kill();
+	this->remove();
+}
+
+void Cgroup::enter() const
+{
+	if (!_write(this->dir_ + "/cgroup.procs", "0")) {
+		OSErr(-1, {}, "failed to enter cgroup %s", this->dir_.c_str());
+	}
+}
+
+Cgroup::Stats Cgroup::stats() const
+{
+	Stats s;
+
+	s.memory_peak_ = strtoull(_read(this->dir_ + "/memory.peak").c_str(),
+							  nullptr, 10);
+
+	auto usage = _field(_read(this->dir_ + "/cpu.stat"), "usage_usec");
+	s.cpu_usec_ = strtoull(usage.c_str(), nullptr, 10);
+
+	return s;
+}
+
+void Cgroup::kill() const
+{
+	// cgroup.kill is only in newer kernels: without it, there's a race with
+	// anything that forks while being killed, so keep at it.
+	if (!_write(this->dir_ + "/cgroup.kill", "1")) {
+		pid_t pid;
+		std::istringstream is(_read(this->dir_ + "/cgroup.procs"));
+
+		while (is >> pid) {
+			::kill(pid, SIGKILL);
+		}
+	}
+}
+
+bool Cgroup::remove() const
+{
+	return rmdir(this->dir_.c_str()) == 0 || errno == ENOENT;
+}
+
+/**
+ * Controllers enabled for the children of the given cgroup
+ */
+static std::set<std::string> _subtree(const std::string &dir)
+{
+	std::string word;
+	std::set<std::string> ctrls;
+	std::istringstream is(_read(dir + "/cgroup.subtree_control"));
+
+	while (is >> word) {
+		ctrls.insert(word);
+	}
+
+	return ctrls;
+}
+
+std::string Cgroups::current()
+{
+	auto mount = _v2Mount();
+	if (mount.size() == 0) {
+		Err(-1, "cgroups: no cgroup v2 hierarchy is mounted");
+	}
+
+	auto self = _self();
+	if (self.size() == 0) {
+		Err(-1, "cgroups: this process isn't in a cgroup v2 hierarchy");
+	}
+
+	return self == "/" ? mount : mount + self;
+}
+
+sp<Cgroups> Cgroups::create(const Cgroup::Limits &need)
+{
+	return mksp<Cgroups>(current(), need);
+}
+
+Cgroups::Cgroups(const std::string &parent, const Cgroup::Limits &need)
+	: parent_(parent), dir_(parent + "/paratec-" + std::to_string(getpid()))
+{
+	int err = mkdir(this->dir_.c_str(), 0755);
+	OSErr(err, {}, "failed to create cgroup %s: has %s been delegated?",
+		  this->dir_.c_str(), parent.c_str());
+
+	auto runner = this->dir_ + "/runner";
+	err = mkdir(runner.c_str(), 0755);
+	if (err != 0) {
+		rmdir(this->dir_.c_str());
+		OSErr(err, {}, "failed to create cgroup %s", runner.c_str());
+	}
+
+	// Only cgroups without any processes can give controllers to their
+	// children (the root aside), so get out of the way. If this was the only
+	// process in the parent, that empties it out.
+	if (!_write(runner + "/cgroup.procs", "0")) {
+		rmdir(runner.c_str());
+		rmdir(this->dir_.c_str());
+		OSErr(-1, {}, "failed to move into cgroup %s", runner.c_str());
+	}
+
+	const std::pair<const char *, bool> ctrls[] = {
+		// Always wanted for memory.peak
+		{ "memory", need.memory_max_ > 0 },
+		{ "cpu", need.cpu_max_ > 0 },
+		{ "pids", need.pids_max_ > 0 },
+	};
+
+	auto had = _subtree(parent);
+
+	for (const auto &ctrl : ctrls) {
+		std::string enable = std::string("+") + ctrl.first;
+
+		// Controllers can only be enabled for the subtree if they're enabled
+		// for its parent. That fails if anything else is in the parent, which
+		// is fine as long as nothing needs the controller.
+		if (had.count(ctrl.first) == 0
+			&& _write(parent + "/cgroup.subtree_control", enable)) {
+			this->parent_ctrls_.insert(ctrl.first);
+		}
+
+		_write(this->dir_ + "/cgroup.subtree_control", enable);
+
+		bool enabled = _subtree(this->dir_).count(ctrl.first) > 0;
+		if (ctrl.second && !enabled) {
+			this->leave();
+			Err(-1, "cgroups: the %s controller isn't available in %s",
+				ctrl.first, parent.c_str());
+		}
+
+		if (enabled) {
+			this->ctrls_.insert(ctrl.first);
+		}
+	}
+}
+
+Cgroups::~Cgroups()
+{
+	this->drain();
+	this->dying_.clear();
+	this->leave();
+}
+
+void Cgroups::leave()
+{
+	// The parent can't take this process back while it has controllers
+	// enabled for its children. If another process is using them, too,
+	// there's no going back, and the subtree is left for whoever cleans up
+	// after this process.
+	for (const auto &ctrl : this->ctrls_) {
+		_write(this->dir_ + "/cgroup.subtree_control", "-" + ctrl);
+	}
+
+	for (const auto &ctrl : this->parent_ctrls_) {
+		_write(this->parent_ + "/cgroup.subtree_control", "-" + ctrl);
+	}
+
+	if (_write(this->parent_ + "/cgroup.procs", "0")) {
+		rmdir((this->dir_ + "/runner").c_str());
+		rmdir(this->dir_.c_str());
+	}
+}
+
+sp<Cgroup> Cgroups::make(const Cgroup::Limits &limits)
+{
+	const std::pair<const char *, bool> ctrls[] = {
+		{ "memory", limits.memory_max_ > 0 },
+		{ "cpu", limits.cpu_max_ > 0 },
+		{ "pids", limits.pids_max_ > 0 },
+	};
+
+	// Without its controller, a limit would just be ignored
+	for (const auto &ctrl : ctrls) {
+		if (ctrl.second && this->ctrls_.count(ctrl.first) == 0) {
+			Err(-1, "cgroups: can't limit a test: the %s controller isn't "
+					"enabled in %s",
+				ctrl.first, this->dir_.c_str());
+		}
+	}
+
+	return mksp<Cgroup>(this->dir_ + "/" + std::to_string(this->next_++),
+						limits);
+}
+
+void Cgroups::release(sp<Cgroup> cg)
+{
+	cg->kill();
+	if (!cg->remove()) {
+		this->dying_.push_back(std::move(cg));
+	}
+}
+
+bool Cgroups::reap()
+{
+	auto it = this->dying_.begin();
+	while (it != this->dying_.end()) {
+		if ((*it)->remove()) {
+			it = this->dying_.erase(it);
+		} else {
+			++it;
+		}
+	}
+
+	return this->dying_.size() == 0;
+}
+
+void Cgroups::drain()
+{
+	int i;
+
+	for (i = 0; i < kDrainWaitMs && !this->reap(); i++) {
+		usleep(1000);
+	}
+}
+}
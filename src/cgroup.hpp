@@ -0,0 +1,171 @@
+/**
+ * @file
+ * @author Andrew Stone <a@stoney.io>
+ * @copyright 2016 Andrew Stone
+ *
+ * This file is part of paratec and is released under the MIT License:
+ * http://opensource.org/licenses/MIT
+ */
+
+#pragma once
+#include <set>
+#include <string>
+#include <vector>
+#include "std.hpp"
+
+namespace pt
+{
+
+/**
+ * A cgroup (v2) that a single test runs in. Unlike a process group, nothing
+ * can leave a cgroup without being moved out of it, so killing the cgroup
+ * kills everything the test started, daemons and all.
+ */
+class Cgroup
+{
+	std::string dir_;
+
+public:
+	/**
+	 * What the test may use. 0 for no limit.
+	 */
+	struct Limits {
+		uint64_t memory_max_ = 0;
+		double cpu_max_ = 0;
+		uint64_t pids_max_ = 0;
+	};
+
+	/**
+	 * What the test used
+	 */
+	struct Stats {
+		/**
+		 * 0 when the memory controller isn't available
+		 */
+		uint64_t memory_peak_ = 0;
+		uint64_t cpu_usec_ = 0;
+	};
+
+	/**
+	 * Create the cgroup at the given path, with the given limits
+	 */
+	Cgroup(std::string dir, const Limits &limits);
+	Cgroup(const Cgroup &) = delete;
+
+	/**
+	 * Kills anything left in the cgroup, and removes it if that's already
+	 * emptied it out
+	 */
+	~Cgroup();
+
+	inline const std::string &dir() const
+	{
+		return this->dir_;
+	}
+
+	/**
+	 * Move the calling process into the cgroup. Only ever called from a
+	 * forked test.
+	 */
+	void enter() const;
+
+	Stats stats() const;
+
+	/**
+	 * Kill everything in the cgroup. Everything takes a moment to die, so
+	 * this doesn't wait for it: see remove().
+	 */
+	void kill() const;
+
+	/**
+	 * Remove the cgroup, which only works once everything in it has died.
+	 * Returns false while something is still dying.
+	 */
+	bool remove() const;
+};
+
+/**
+ * The subtree all tests' cgroups are created in: a child of the cgroup this
+ * process is in, which must have been delegated to it.
+ */
+class Cgroups
+{
+	/**
+	 * Where this process was before moving into the subtree
+	 */
+	std::string parent_;
+	std::string dir_;
+	uint64_t next_ = 0;
+
+	/**
+	 * Controllers enabled for the tests' cgroups
+	 */
+	std::set<std::string> ctrls_;
+
+	/**
+	 * Controllers this enabled in the parent, which have to be disabled
+	 * again before this process can move back
+	 */
+	std::set<std::string> parent_ctrls_;
+
+	/**
+	 * Cgroups that were killed but still have something dying in them
+	 */
+	std::vector<sp<Cgroup>> dying_;
+
+	/**
+	 * Move this process back to the parent and remove the subtree
+	 */
+	void leave();
+
+public:
+	/**
+	 * Path to the cgroup this process is in
+	 */
+	static std::string current();
+
+	/**
+	 * Create the subtree under the cgroup this process is in, with the
+	 * controllers needed to enforce the given limits.
+	 */
+	static sp<Cgroups> create(const Cgroup::Limits &need);
+
+	/**
+	 * Create the subtree under the given cgroup, which this process must be
+	 * in. A cgroup with processes in it can't give controllers to its
+	 * children, so this process moves into the subtree, too, out of the
+	 * tests' way, until this is destroyed.
+	 */
+	Cgroups(const std::string &parent, const Cgroup::Limits &need);
+	Cgroups(const Cgroups &) = delete;
+	~Cgroups();
+
+	inline const std::string &dir() const
+	{
+		return this->dir_;
+	}
+
+	/**
+	 * Create a new cgroup for a test. Fails if any of the limits can't be
+	 * enforced.
+	 */
+	sp<Cgroup> make(const Cgroup::Limits &limits);
+
+	/**
+	 * Kill everything in a test's cgroup, which is removed once it has
+	 * emptied out: see reap().
+	 */
+	void release(sp<Cgroup> cg);
+
+	/**
+	 * Remove every released cgroup that has emptied out. Returns false while
+	 * any are still dying.
+	 */
+	bool reap();
+
+	/**
+	 * Wait, for a little while, for all released cgroups to be removed
+	 */
+	void drain();
+};
+}
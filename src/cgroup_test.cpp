@@ -0,0 +1,234 @@
+/**
+ * @author Andrew Stone <a@stoney.io>
+ * @copyright 2016 Andrew Stone
+ *
+ * This file is part of paratec and is released under the MIT License:
+ * http://opensource.org/licenses/MIT
+ */
+
+#include <fstream>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "cgroup.hpp"
+#include "err.hpp"
+#include "main.hpp"
+#include "util.hpp"
+#include "util_test.hpp"
+
+namespace pt
+{
+
+/**
+ * Skip unless this process is allowed to make cgroups with everything needed
+ * for the given limits.
+ */
+static void _needCgroups(const Cgroup::Limits &need)
+{
+	try {
+		Cgroups::create(need);
+	} catch (const Err &) {
+		pt_skip();
+	}
+}
+
+/**
+ * Gone, or waiting for someone to reap it
+ */
+static bool _dead(pid_t pid)
+{
+	std::string stat;
+	std::ifstream f("/proc/" + std::to_string(pid) + "/stat");
+
+	if (!std::getline(f, stat)) {
+		return true;
+	}
+
+	auto paren = stat.rfind(')');
+	return paren != std::string::npos && stat.substr(paren + 2, 1) == "Z";
+}
+
+TEST(_cgroupDaemon)
+{
+	auto pid = fork();
+	pt_ne(pid, -1);
+
+	if (pid == 0) {
+		// Out of the test's process group, where nothing else would find it
+		setsid();
+
+		auto daemon = fork();
+		if (daemon == 0) {
+			while (true) {
+				pause();
+			}
+		}
+
+		std::ofstream(getenv("PT_CGROUP_DAEMON")) << daemon;
+		_exit(0);
+	}
+
+	waitpid(pid, nullptr, 0);
+
+	// Give the accounting something to see
+	volatile uint64_t spin = 0;
+	while (spin < 10000000) {
+		spin++;
+	}
+}
+
+TEST(_cgroupHog, PTMEMORYMAX(16 * 1024 * 1024))
+{
+	size_t i;
+	const size_t size = 256 * 1024 * 1024;
+	auto volatile p = (char *)malloc(size);
+
+	for (i = 0; i < size; i += 4096) {
+		p[i] = 1;
+	}
+}
+
+TEST(cgroupKillsDaemons)
+{
+	std::stringstream out;
+	char path[] = "/tmp/paratec-cgroup-XXXXXX";
+
+	_needCgroups({});
+
+	pt_ne(mkstemp(path), -1);
+	setenv("PT_CGROUP_DAEMON", path, 1);
+
+	Main m({ MKTEST(_cgroupDaemon) });
+	auto rslts = m.run(out, { "paratec", "--cgroup" });
+
+	pt_eq(rslts.exitCode(), 0);
+	pt_gt(rslts.get("_cgroupDaemon").cpu_usec_, (uint64_t)0);
+
+	pid_t daemon = 0;
+	std::ifstream(path) >> daemon;
+	unlink(path);
+
+	pt_gt(daemon, 0);
+	pt(_dead(daemon));
+}
+
+TEST(cgroupRelease)
+{
+	_needCgroups({});
+
+	auto cgs = Cgroups::create({});
+	auto cg = cgs->make({});
+	auto dir = cg->dir();
+
+	auto pid = fork();
+	pt_ne(pid, -1);
+	if (pid == 0) {
+		cg->enter();
+		pause();
+		_exit(0);
+	}
+
+	std::string procs;
+	while (procs.size() == 0) {
+		std::ifstream(dir + "/cgroup.procs") >> procs;
+	}
+
+	// Nothing's waited for until the end of the run
+	cgs->release(std::move(cg));
+	cgs->drain();
+
+	pt_ne(access(dir.c_str(), F_OK), 0);
+	pt_eq(waitpid(pid, nullptr, 0), pid);
+}
+
+TEST(cgroupMemoryMax)
+{
+	std::stringstream out;
+	Cgroup::Limits need;
+
+	need.memory_max_ = 1;
+	_needCgroups(need);
+
+	Main m({ MKTEST(_cgroupHog) });
+	auto rslts = m.run(out, { "paratec", "--cgroup" });
+
+	pt_eq(rslts.exitCode(), 1);
+	pt_eq(rslts.get("_cgroupHog").signal_num_, SIGKILL);
+	pt_gt(rslts.get("_cgroupHog").memory_peak_, (uint64_t)0);
+}
+
+static bool _hasController(const std::string &dir, const std::string &ctrl)
+{
+	std::string word;
+	std::ifstream f(dir + "/cgroup.controllers");
+
+	while (f >> word) {
+		if (word == ctrl) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+TEST(cgroupNonRoot)
+{
+	_needCgroups({});
+
+	// Like a delegated scope: a cgroup that isn't the root, with this
+	// process in it
+	auto top = Cgroups::current();
+	auto dir = top + "/paratec-nonroot-" + std::to_string(getpid());
+	pt_eq(mkdir(dir.c_str(), 0755), 0);
+
+	DTor d([&]() {
+		std::ofstream(top + "/cgroup.procs") << "0";
+		rmdir(dir.c_str());
+	});
+
+	std::ofstream(dir + "/cgroup.procs") << "0";
+	pt_eq(Cgroups::current(), dir);
+
+	{
+		auto cgs = Cgroups::create({});
+		pt_eq(Cgroups::current(), cgs->dir() + "/runner");
+	}
+
+	pt_eq(Cgroups::current(), dir);
+	pt_ne(access((dir + "/paratec-" + std::to_string(getpid())).c_str(), F_OK),
+		  0);
+
+	// Only the limits that the hierarchy can enforce at all can be tested
+	if (!_hasController(dir, "memory")) {
+		return;
+	}
+
+	std::stringstream out;
+
+	Main m({ MKTEST(_cgroupHog) });
+	auto rslts = m.run(out, { "paratec", "--cgroup" });
+
+	pt_eq(rslts.get("_cgroupHog").signal_num_, SIGKILL);
+	pt_gt(rslts.get("_cgroupHog").memory_peak_, (uint64_t)0);
+	pt_eq(Cgroups::current(), dir);
+}
+
+TEST(cgroupLimitNeedsCgroup, PTEXIT(1))
+{
+	std::stringstream out;
+
+	Main m(std::vector<sp<const Test>>{});
+	m.run(out, { "paratec", "--cpu-max=0.5" });
+}
+
+TEST(cgroupNoFork, PTEXIT(1))
+{
+	std::stringstream out;
+
+	Main m(std::vector<sp<const Test>>{});
+	m.run(out, { "paratec", "--cgroup", "--nofork" });
+}
+}
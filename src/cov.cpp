@@ -0,0 +1,198 @@
+/**
+ * @author Andrew Stone <a@stoney.io>
+ * @copyright 2016 Andrew Stone
+ *
+ * This file is part of paratec and is released under the MIT License:
+ * http://opensource.org/licenses/MIT
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "cov.hpp"
+#include "err.hpp"
+#include "fork.hpp"
+
+extern "C" {
+/**
+ * Part of LLVM's profile runtime: only there when the binary was built with
+ * -fprofile-instr-generate.
+ */
+void __llvm_profile_set_filename(const char *name) __attribute__((weak));
+}
+
+namespace pt
+{
+
+static const char *kRawExt = ".profraw";
+
+static std::vector<std::string> _list(const std::string &dir)
+{
+	dirent *ent;
+	std::vector<std::string> files;
+	DIR *dh = opendir(dir.c_str());
+
+	if (dh == nullptr) {
+		return files;
+	}
+
+	while ((ent = readdir(dh)) != nullptr) {
+		if (ent->d_name[0] != '.') {
+			files.push_back(dir + "/" + ent->d_name);
+		}
+	}
+
+	closedir(dh);
+
+	return files;
+}
+
+static bool _endsWith(const std::string &s, const char *end)
+{
+	auto len = strlen(end);
+	return s.size() >= len && s.compare(s.size() - len, len, end) == 0;
+}
+
+/**
+ * Merge profiles with llvm-profdata. Returns an error message on failure.
+ */
+static std::string _merge(const std::vector<std::string> &ins,
+						  const std::string &out)
+{
+	Fork f;
+	auto e = f.run([&]() {
+		std::vector<std::string> args{
+			"llvm-profdata", "merge", "-sparse", "-o", out,
+		};
+		args.insert(args.end(), ins.begin(), ins.end());
+
+		std::vector<char *> argv;
+		for (const auto &a : args) {
+			argv.push_back(const_cast<char *>(a.c_str()));
+		}
+		argv.push_back(nullptr);
+
+		execvp(argv[0], argv.data());
+
+		fprintf(stderr, "failed to exec llvm-profdata: %s\n", strerror(errno));
+		_exit(127);
+	});
+
+	if (e.status_ != 0 || e.signal_ != 0) {
+		return e.stderr_.size() > 0 ? e.stderr_ : "llvm-profdata failed";
+	}
+
+	return "";
+}
+
+sp<Coverage> Coverage::detect()
+{
+	if (__llvm_profile_set_filename == nullptr) {
+		return nullptr;
+	}
+
+	// Right next to where this process's own profile goes
+	std::string dir(".");
+	auto env = getenv("LLVM_PROFILE_FILE");
+	if (env != nullptr && strlen(env) > 0) {
+		std::string path(env);
+		auto slash = path.rfind('/');
+		if (slash != std::string::npos) {
+			dir = path.substr(0, slash);
+		}
+	}
+
+	return mksp<Coverage>(dir + "/paratec-" + std::to_string(getpid())
+						  + ".profdata");
+}
+
+Coverage::Coverage(std::string out) : out_(std::move(out))
+{
+	char dir[] = "/tmp/paratec-cov-XXXXXX";
+
+	if (mkdtemp(dir) == nullptr) {
+		OSErr(-1, {}, "failed to create directory for coverage profiles");
+	}
+
+	this->dir_ = dir;
+	this->pattern_ = this->dir_ + "/%p" + kRawExt;
+}
+
+Coverage::~Coverage()
+{
+	for (const auto &f : _list(this->dir_)) {
+		unlink(f.c_str());
+	}
+
+	rmdir(this->dir_.c_str());
+}
+
+void Coverage::child()
+{
+	if (__llvm_profile_set_filename != nullptr) {
+		__llvm_profile_set_filename(this->pattern_.c_str());
+	}
+}
+
+void Coverage::merge(uint jobs)
+{
+	size_t i;
+	std::vector<std::string> raws;
+
+	for (auto &f : _list(this->dir_)) {
+		if (_endsWith(f, kRawExt)) {
+			raws.push_back(std::move(f));
+		}
+	}
+
+	if (raws.size() == 0) {
+		return;
+	}
+
+	// Every group is merged by its own llvm-profdata, and then the groups
+	// are merged together: llvm-profdata only ever uses one core to read
+	// raw profiles.
+	auto ngroups = std::max(1u, std::min(jobs, (uint)raws.size() / 2));
+	std::vector<std::vector<std::string>> groups(ngroups);
+	for (i = 0; i < raws.size(); i++) {
+		groups[i % ngroups].push_back(raws[i]);
+	}
+
+	if (ngroups == 1) {
+		auto err = _merge(groups[0], this->out_);
+		if (err.size() > 0) {
+			Err(-1, "failed to merge coverage profiles: %s", err.c_str());
+		}
+
+		return;
+	}
+
+	std::vector<std::string> outs(ngroups);
+	std::vector<std::string> errs(ngroups);
+	std::vector<std::thread> ths;
+
+	for (i = 0; i < ngroups; i++) {
+		outs[i] = this->dir_ + "/" + std::to_string(i) + ".profdata";
+		ths.emplace_back([&, i]() { errs[i] = _merge(groups[i], outs[i]); });
+	}
+
+	for (auto &th : ths) {
+		th.join();
+	}
+
+	for (const auto &err : errs) {
+		if (err.size() > 0) {
+			Err(-1, "failed to merge coverage profiles: %s", err.c_str());
+		}
+	}
+
+	auto err = _merge(outs, this->out_);
+	if (err.size() > 0) {
+		Err(-1, "failed to merge coverage profiles: %s", err.c_str());
+	}
+}
+}
@@ -0,0 +1,71 @@
+/**
+ * @file
+ * @author Andrew Stone <a@stoney.io>
+ * @copyright 2016 Andrew Stone
+ *
+ * This file is part of paratec and is released under the MIT License:
+ * http://opensource.org/licenses/MIT
+ */
+
+#pragma once
+#include <string>
+#include "std.hpp"
+
+namespace pt
+{
+
+/**
+ * Keeps forked tests from fighting over LLVM's profile (-fprofile-instr-
+ * generate) output. Every forked test writes its own profile into a private
+ * directory, and they're all merged together once the tests are done.
+ *
+ * gcov-style coverage (--coverage) needs none of this: its runtime locks
+ * each .gcda file while merging into it.
+ */
+class Coverage
+{
+	std::string dir_;
+
+	/**
+	 * Where the merged profile goes
+	 */
+	std::string out_;
+
+	/**
+	 * LLVM's runtime holds onto the pattern it's given rather than copying
+	 * it, so it has to live somewhere.
+	 */
+	std::string pattern_;
+
+public:
+	/**
+	 * If the binary was built with LLVM's profile runtime, the coverage of
+	 * its forked tests; null otherwise.
+	 */
+	static sp<Coverage> detect();
+
+	/**
+	 * Collect the profiles of forked tests, merging them into `out`.
+	 */
+	Coverage(std::string out);
+	Coverage(const Coverage &) = delete;
+	~Coverage();
+
+	inline const std::string &dir() const
+	{
+		return this->dir_;
+	}
+
+	/**
+	 * Send this process's profile into the directory. Only ever called
+	 * from a forked test.
+	 */
+	void child();
+
+	/**
+	 * Merge every profile written, running up to `jobs` merges at once.
+	 * Does nothing if no profiles were written.
+	 */
+	void merge(uint jobs);
+};
+}
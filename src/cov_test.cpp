@@ -0,0 +1,105 @@
+/**
+ * @author Andrew Stone <a@stoney.io>
+ * @copyright 2016 Andrew Stone
+ *
+ * This file is part of paratec and is released under the MIT License:
+ * http://opensource.org/licenses/MIT
+ */
+
+#include <fstream>
+#include <unistd.h>
+#include "cov.hpp"
+#include "fork.hpp"
+#include "main.hpp"
+#include "util.hpp"
+#include "util_test.hpp"
+
+namespace pt
+{
+
+TEST(_covPass)
+{
+}
+
+/**
+ * Raw profiles only come from LLVM's runtime, but llvm-profdata happily
+ * merges the same counters written as text.
+ */
+static void _writeProfile(const std::string &path, int count)
+{
+	std::ofstream f(path, std::ios::trunc);
+	f << "covFn\n"
+	  << "1234\n"
+	  << "1\n"
+	  << count << "\n";
+}
+
+static std::string _showProfile(const std::string &path)
+{
+	Fork f;
+	auto e = f.run([&]() {
+		execlp("llvm-profdata", "llvm-profdata", "show", "--all-functions",
+			   path.c_str(), nullptr);
+		_exit(127);
+	});
+
+	pt_eq(e.status_, 0);
+
+	return e.stdout_;
+}
+
+static void _covMerge(uint jobs)
+{
+	char out[] = "/tmp/paratec-cov-out-XXXXXX";
+	int fd = mkstemp(out);
+	pt(fd >= 0);
+	close(fd);
+
+	DTor d([&]() { unlink(out); });
+
+	{
+		Coverage c(out);
+		for (int i = 1; i <= 10; i++) {
+			_writeProfile(c.dir() + "/" + std::to_string(i) + ".profraw", i);
+		}
+
+		c.merge(jobs);
+	}
+
+	pt_in("Function count: 55", _showProfile(out));
+}
+
+TEST(covMerge)
+{
+	_covMerge(1);
+}
+
+TEST(covMergeParallel)
+{
+	_covMerge(4);
+}
+
+TEST(covMergeNothing)
+{
+	std::string out;
+
+	{
+		Coverage c("/tmp/paratec-cov-none.profdata");
+		out = c.dir();
+		c.merge(4);
+	}
+
+	pt_eq(access("/tmp/paratec-cov-none.profdata", F_OK), -1);
+	pt_eq(access(out.c_str(), F_OK), -1);
+}
+
+TEST(covLock)
+{
+	std::stringstream out;
+
+	Main m({ MKTEST(_covPass) });
+	auto rslts = m.run(out, { "paratec", "--cov-lock", "-j", "4" });
+
+	pt_eq(rslts.exitCode(), 0);
+}
+}
@@ -0,0 +1,386 @@
+/**
+ * @author Andrew Stone <a@stoney.io>
+ * @copyright 2016 Andrew Stone
+ *
+ * This file is part of paratec and is released under the MIT License:
+ * http://opensource.org/licenses/MIT
+ */
+
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <sched.h>
+#include <sstream>
+#include <string>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include "cpu.hpp"
+#include "err.hpp"
+#include "std.hpp"
+
+#ifdef PT_DARWIN
+#include <sys/sysctl.h>
+#endif
+
+namespace pt
+{
+namespace cpu
+{
+
+static constexpr size_t kLine = 64;
+
+/**
+ * Never evict with less than this, in case cache detection comes up short
+ */
+static constexpr size_t kMinEvict = 16 * 1024 * 1024;
+
+#ifdef PT_LINUX
+
+/**
+ * Read sizes out of sysfs, for when glibc doesn't know them (ARM, some
+ * virtualized environments).
+ */
+static void _sysfsCaches(Caches *c)
+{
+	int i;
+
+	for (i = 0;; i++) {
+		std::string dir("/sys/devices/system/cpu/cpu0/cache/index");
+		dir += std::to_string(i);
+
+		std::ifstream flevel(dir + "/level");
+		std::ifstream ftype(dir + "/type");
+		std::ifstream fsize(dir + "/size");
+		if (!flevel.good() || !ftype.good() || !fsize.good()) {
+			break;
+		}
+
+		int level;
+		std::string type;
+		size_t size;
+		char unit = 0;
+
+		flevel >> level;
+		ftype >> type;
+		fsize >> size >> unit;
+
+		if (type == "Instruction") {
+			continue;
+		}
+
+		if (unit == 'K') {
+			size *= 1024;
+		} else if (unit == 'M') {
+			size *= 1024 * 1024;
+		}
+
+		switch (level) {
+		case 1:
+			c->l1_ = c->l1_ ?: size;
+			break;
+
+		case 2:
+			c->l2_ = c->l2_ ?: size;
+			break;
+
+		case 3:
+			c->l3_ = c->l3_ ?: size;
+			break;
+		}
+	}
+}
+
+#endif
+
+Caches caches()
+{
+	Caches c{ 0, 0, 0 };
+
+#ifdef PT_LINUX
+
+	auto get = [](int name) {
+		auto v = sysconf(name);
+		return v > 0 ? (size_t)v : 0;
+	};
+
+	c.l1_ = get(_SC_LEVEL1_DCACHE_SIZE);
+	c.l2_ = get(_SC_LEVEL2_CACHE_SIZE);
+	c.l3_ = get(_SC_LEVEL3_CACHE_SIZE);
+
+	if (c.l1_ == 0 || c.l2_ == 0) {
+		_sysfsCaches(&c);
+	}
+
+#elif defined(PT_DARWIN)
+
+	auto get = [](const char *name) {
+		uint64_t v = 0;
+		size_t len = sizeof(v);
+		int err = sysctlbyname(name, &v, &len, NULL, 0);
+		return err == 0 ? (size_t)v : 0;
+	};
+
+	c.l1_ = get("hw.l1dcachesize");
+	c.l2_ = get("hw.l2cachesize");
+	c.l3_ = get("hw.l3cachesize");
+
+#endif
+
+	return c;
+}
+
+std::vector<Tier> tiers()
+{
+	std::vector<Tier> ts;
+	auto c = caches();
+
+	// Use half of each level so that the working set comfortably fits, even
+	// with everything else the process has going on.
+	if (c.l1_ > 0) {
+		ts.push_back({ "L1", c.l1_ / 2 });
+	}
+
+	if (c.l2_ > 0) {
+		ts.push_back({ "L2", c.l2_ / 2 });
+	}
+
+	if (c.l3_ > 0) {
+		ts.push_back({ "L3", c.l3_ / 2 });
+	}
+
+	ts.push_back({ "DRAM", std::max(kMinEvict, 2 * c.llc()) });
+
+	return ts;
+}
+
+#ifdef PT_LINUX
+
+/**
+ * From linux/mempolicy.h, which isn't always installed
+ */
+static constexpr int kMpolPreferred = 1;
+
+/**
+ * Parse a sysfs CPU list, like `0-3,8,10-11`
+ */
+static std::vector<int> _cpuList(const std::string &path)
+{
+	std::string range;
+	std::vector<int> cpus;
+	std::ifstream f(path);
+
+	while (std::getline(f, range, ',')) {
+		int low;
+		int high;
+		char dash;
+		std::istringstream is(range);
+
+		if (!(is >> low)) {
+			continue;
+		}
+
+		high = low;
+		if (is >> dash >> high && dash != '-') {
+			high = low;
+		}
+
+		for (; low <= high; low++) {
+			cpus.push_back(low);
+		}
+	}
+
+	return cpus;
+}
+
+std::vector<Slot> slots(size_t n)
+{
+	struct Core {
+		int node_;
+		std::vector<int> cpus_;
+	};
+
+	int cpu;
+	size_t i;
+	size_t nnodes;
+	cpu_set_t allowed;
+	std::map<int, int> nodes;
+	std::map<std::string, Core> by_siblings;
+
+	int err = sched_getaffinity(0, sizeof(allowed), &allowed);
+	OSErr(err, {}, "failed to get CPU affinity");
+
+	for (i = 0;; i++) {
+		auto dir = "/sys/devices/system/node/node" + std::to_string(i);
+		if (access(dir.c_str(), F_OK) != 0) {
+			break;
+		}
+
+		for (auto c : _cpuList(dir + "/cpulist")) {
+			nodes[c] = (int)i;
+		}
+	}
+
+	nnodes = i;
+
+	for (cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+		if (!CPU_ISSET(cpu, &allowed)) {
+			continue;
+		}
+
+		std::string siblings;
+		std::ifstream f("/sys/devices/system/cpu/cpu" + std::to_string(cpu)
+						+ "/topology/thread_siblings_list");
+		if (!std::getline(f, siblings)) {
+			siblings = std::to_string(cpu);
+		}
+
+		auto &core = by_siblings[siblings];
+		auto node = nodes.find(cpu);
+		core.node_ = node == nodes.end() ? -1 : node->second;
+		core.cpus_.push_back(cpu);
+	}
+
+	std::vector<Core> cores;
+	for (auto &c : by_siblings) {
+		cores.push_back(std::move(c.second));
+	}
+
+	// Keep each node's cores together, so that slots rarely span nodes
+	std::sort(cores.begin(), cores.end(), [](const Core &a, const Core &b) {
+		if (a.node_ != b.node_) {
+			return a.node_ < b.node_;
+		}
+
+		return a.cpus_[0] < b.cpus_[0];
+	});
+
+	std::vector<Slot> ss(n);
+	const bool numa = nnodes > 1;
+
+	if (n <= cores.size()) {
+		for (i = 0; i < n; i++) {
+			auto &s = ss[i];
+
+			for (auto c = i * cores.size() / n;
+				 c < (i + 1) * cores.size() / n; c++) {
+				s.cpus_.insert(s.cpus_.end(), cores[c].cpus_.begin(),
+							   cores[c].cpus_.end());
+			}
+
+			s.node_ = numa ? cores[i * cores.size() / n].node_ : -1;
+		}
+
+		return ss;
+	}
+
+	// The first thread of every core, then the second of every core, ...
+	std::vector<const Core *> owners;
+	std::vector<int> threads;
+	for (size_t t = 0; threads.size() < (size_t)CPU_COUNT(&allowed); t++) {
+		for (const auto &c : cores) {
+			if (t < c.cpus_.size()) {
+				threads.push_back(c.cpus_[t]);
+				owners.push_back(&c);
+			}
+		}
+	}
+
+	for (i = 0; i < n; i++) {
+		ss[i].cpus_.push_back(threads[i % threads.size()]);
+		ss[i].node_ = numa ? owners[i % threads.size()]->node_ : -1;
+	}
+
+	return ss;
+}
+
+void pin(const Slot &s)
+{
+	cpu_set_t set;
+
+	CPU_ZERO(&set);
+	for (auto c : s.cpus_) {
+		CPU_SET(c, &set);
+	}
+
+	int err = sched_setaffinity(0, sizeof(set), &set);
+	OSErr(err, {}, "failed to pin to CPUs");
+
+	// Preferred rather than bound: a test that needs more memory than its
+	// node has is better off slow than dead.
+	if (s.node_ >= 0) {
+		unsigned long mask[16] = {};
+		auto bits = sizeof(mask[0]) * 8;
+
+		if ((size_t)s.node_ < NELS(mask) * bits) {
+			mask[s.node_ / bits] |= 1ul << (s.node_ % bits);
+			err = (int)syscall(SYS_set_mempolicy, kMpolPreferred, mask,
+							   NELS(mask) * bits);
+			OSErr(err, {}, "failed to prefer memory from node %d", s.node_);
+		}
+	}
+}
+
+#else
+
+std::vector<Slot> slots(size_t)
+{
+	Err(-1, "pinning isn't supported on this platform");
+	return {};
+}
+
+void pin(const Slot &)
+{
+	Err(-1, "pinning isn't supported on this platform");
+}
+
+#endif
+
+Evictor::Evictor(bool tlb) : tlb_(tlb)
+{
+	auto c = caches();
+	this->size_ = std::max(kMinEvict, c.l1_ + c.l2_ + c.l3_ + c.llc() / 2);
+	this->map();
+}
+
+Evictor::~Evictor()
+{
+	munmap(this->buff_, this->size_);
+}
+
+void Evictor::map()
+{
+	if (this->buff_ != nullptr) {
+		munmap(this->buff_, this->size_);
+	}
+
+	this->buff_ = (char *)mmap(NULL, this->size_, PROT_READ | PROT_WRITE,
+							   MAP_ANON | MAP_PRIVATE, -1, 0);
+	OSErr(this->buff_ == MAP_FAILED ? -1 : 0, {},
+		  "failed to map cache eviction buffer");
+
+#ifdef MADV_NOHUGEPAGE
+	// Huge pages would cover the buffer with too few TLB entries to push
+	// anything else out.
+	if (this->tlb_) {
+		madvise(this->buff_, this->size_, MADV_NOHUGEPAGE);
+	}
+#endif
+}
+
+void Evictor::evict()
+{
+	size_t i;
+	volatile char *b;
+
+	if (this->tlb_) {
+		this->map();
+	}
+
+	b = this->buff_;
+	for (i = 0; i < this->size_; i += kLine) {
+		b[i] = (char)(b[i] + 1);
+	}
+}
+}
+}
@@ -0,0 +1,119 @@
+/**
+ * @file
+ * @author Andrew Stone <a@stoney.io>
+ * @copyright 2016 Andrew Stone
+ *
+ * This file is part of paratec and is released under the MIT License:
+ * http://opensource.org/licenses/MIT
+ */
+
+#pragma once
+#include <stddef.h>
+#include <vector>
+#include "paratec.h"
+
+namespace pt
+{
+namespace cpu
+{
+
+/**
+ * Sizes of the data caches, in bytes. Levels that don't exist are 0.
+ */
+struct Caches {
+	size_t l1_;
+	size_t l2_;
+	size_t l3_;
+
+	/**
+	 * Size of the last-level cache
+	 */
+	inline size_t llc() const
+	{
+		return this->l3_ ?: this->l2_ ?: this->l1_;
+	}
+};
+
+/**
+ * A working-set size that fits in (or, for DRAM, overflows) a level of the
+ * memory hierarchy.
+ */
+struct Tier {
+	const char *name_;
+	size_t size_;
+};
+
+/**
+ * Get the sizes of this machine's caches
+ */
+Caches caches();
+
+/**
+ * Working-set sizes for each level of the memory hierarchy, smallest first.
+ */
+std::vector<Tier> tiers();
+
+/**
+ * Pinning needs sched_setaffinity() and the topology in sysfs
+ */
+#ifdef PT_LINUX
+static constexpr bool kPinSupported = true;
+#else
+static constexpr bool kPinSupported = false;
+#endif
+
+/**
+ * CPUs that a job is pinned to, and the NUMA node they're on
+ */
+struct Slot {
+	std::vector<int> cpus_;
+
+	/**
+	 * -1 when there's only 1 node, and memory placement doesn't matter
+	 */
+	int node_ = -1;
+};
+
+/**
+ * Split the CPUs this process may run on into `n` slots. Each slot gets whole
+ * cores (with all of their SMT siblings), from a single NUMA node where
+ * possible. When there are more slots than cores, each gets a single
+ * hardware thread, spread across cores before doubling up on siblings; when
+ * there are more slots than hardware threads, slots share them.
+ */
+std::vector<Slot> slots(size_t n);
+
+/**
+ * Run the calling process only on the slot's CPUs, and prefer memory from its
+ * node
+ */
+void pin(const Slot &s);
+
+/**
+ * Evicts everything from the CPU caches by streaming through a buffer larger
+ * than the last-level cache.
+ */
+class Evictor
+{
+	char *buff_ = nullptr;
+	size_t size_;
+	bool tlb_;
+
+	void map();
+
+public:
+	/**
+	 * If `tlb`, the buffer is re-mapped before every eviction, so that
+	 * touching it also pushes everything else out of the TLB.
+	 */
+	Evictor(bool tlb);
+	Evictor(const Evictor &) = delete;
+	~Evictor();
+
+	/**
+	 * Evict the caches
+	 */
+	void evict();
+};
+}
+}
@@ -0,0 +1,113 @@
+/**
+ * @author Andrew Stone <a@stoney.io>
+ * @copyright 2016 Andrew Stone
+ *
+ * This file is part of paratec and is released under the MIT License:
+ * http://opensource.org/licenses/MIT
+ */
+
+#include <sched.h>
+#include <set>
+#include "cpu.hpp"
+#include "main.hpp"
+#include "util_test.hpp"
+
+namespace pt
+{
+namespace cpu
+{
+
+TEST(cpuCaches)
+{
+	auto c = caches();
+
+	pt_gt(c.llc(), (size_t)0);
+	pt_ge(c.llc(), c.l1_);
+}
+
+TEST(cpuTiers)
+{
+	auto ts = tiers();
+
+	pt_ge(ts.size(), (size_t)2);
+	pt_eq(std::string(ts.back().name_), "DRAM");
+	pt_gt(ts.back().size_, caches().llc());
+
+	for (size_t i = 1; i < ts.size(); i++) {
+		pt_gt(ts[i].size_, ts[i - 1].size_);
+	}
+}
+
+TEST(cpuEvict)
+{
+	Evictor e(false);
+	e.evict();
+	e.evict();
+}
+
+TEST(cpuEvictTLB)
+{
+	Evictor e(true);
+	e.evict();
+	e.evict();
+}
+
+TEST(cpuSlots)
+{
+	size_t n;
+	cpu_set_t allowed;
+
+	pt_eq(sched_getaffinity(0, sizeof(allowed), &allowed), 0);
+	const auto ncpus = (size_t)CPU_COUNT(&allowed);
+
+	for (n = 1; n <= ncpus * 2 + 1; n++) {
+		std::set<int> seen;
+		auto ss = slots(n);
+
+		pt_eq(ss.size(), n);
+
+		for (const auto &s : ss) {
+			pt_gt(s.cpus_.size(), (size_t)0);
+
+			for (auto c : s.cpus_) {
+				bool ok = CPU_ISSET(c, &allowed);
+				pt(ok);
+
+				// Slots only share CPUs once there aren't enough to go around
+				pt(seen.insert(c).second || n > ncpus);
+			}
+		}
+
+		if (n <= ncpus) {
+			pt_eq(seen.size(), ncpus);
+		}
+	}
+}
+
+TEST(_cpuPinned)
+{
+	cpu_set_t set;
+
+	pt_eq(sched_getaffinity(0, sizeof(set), &set), 0);
+	pt_eq(CPU_COUNT(&set), 1);
+}
+
+TEST(cpuPin)
+{
+	std::stringstream out;
+
+	Main m({ MKTEST(_cpuPinned) });
+	auto rslts = m.run(out, { "paratec", "--pin", "-j", "64" });
+
+	pt_eq(rslts.exitCode(), 0);
+}
+
+TEST(cpuPinNoFork, PTEXIT(1))
+{
+	std::stringstream out;
+
+	Main m(std::vector<sp<const Test>>{});
+	m.run(out, { "paratec", "--pin", "--nofork" });
+}
+}
+}
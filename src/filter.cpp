@@ -0,0 +1,242 @@
+/**
+ * @author Andrew Stone <a@stoney.io>
+ * @copyright 2016 Andrew Stone
+ *
+ * This file is part of paratec and is released under the MIT License:
+ * http://opensource.org/licenses/MIT
+ */
+
+#include <string.h>
+#include "err.hpp"
+#include "filter.hpp"
+
+namespace pt
+{
+
+void Filter::add(bool neg, std::string f)
+{
+	this->count_++;
+	this->has_pos_ |= !neg;
+
+	if (f.size() >= 2 && f.front() == '/' && f.back() == '/') {
+		auto re = f.substr(1, f.size() - 2);
+
+		try {
+			this->regexes_.push_back({ neg, std::regex(re) });
+		} catch (std::regex_error &e) {
+			Err(-1, "filter: `%s` is not a valid regex: %s", re.c_str(),
+				e.what());
+		}
+
+		return;
+	}
+
+	if (f.find_first_of("*?[") != std::string::npos) {
+		this->globs_.push_back({ neg, std::move(f) });
+		return;
+	}
+
+	this->addPrefix(neg, f);
+}
+
+void Filter::addPrefix(bool neg, const std::string &f)
+{
+	size_t n = 0;
+
+	for (auto c : f) {
+		this->trie_[n].pos_below_ |= !neg;
+
+		auto it = this->trie_[n].next_.find(c);
+		if (it != this->trie_[n].next_.end()) {
+			n = it->second;
+			continue;
+		}
+
+		auto next = this->trie_.size();
+		this->trie_[n].next_[c] = next;
+		this->trie_.emplace_back();
+		n = next;
+	}
+
+	this->trie_[n].pos_ |= !neg;
+	this->trie_[n].neg_ |= neg;
+}
+
+bool Filter::globMatch(const std::string &pat, const char *name)
+{
+	const char *p = pat.c_str();
+	const char *n = name;
+
+	// Where to resume from when a match after the last `*` fails
+	const char *star_p = nullptr;
+	const char *star_n = nullptr;
+
+	while (*n != '\0') {
+		bool ok = false;
+		const char *pnext = p + 1;
+
+		switch (*p) {
+		case '*':
+			star_p = ++p;
+			star_n = n;
+			continue;
+
+		case '?':
+			ok = true;
+			break;
+
+		case '[': {
+			const char *c = p + 1;
+			bool negate = *c == '!' || *c == '^';
+			if (negate) {
+				c++;
+			}
+
+			bool in = false;
+			bool first = true;
+			while (*c != '\0' && (*c != ']' || first)) {
+				if (c[1] == '-' && c[2] != ']' && c[2] != '\0') {
+					in |= *n >= c[0] && *n <= c[2];
+					c += 3;
+				} else {
+					in |= *n == *c;
+					c++;
+				}
+
+				first = false;
+			}
+
+			// An unterminated class is just a literal `[`
+			if (*c == '\0') {
+				ok = *n == '[';
+			} else {
+				ok = in != negate;
+				pnext = c + 1;
+			}
+
+			break;
+		}
+
+		case '\0':
+			break;
+
+		default:
+			ok = *p == *n;
+			break;
+		}
+
+		if (ok) {
+			p = pnext;
+			n++;
+		} else if (star_p != nullptr) {
+			p = star_p;
+			n = ++star_n;
+		} else {
+			return false;
+		}
+	}
+
+	while (*p == '*') {
+		p++;
+	}
+
+	return *p == '\0';
+}
+
+Filter::Match Filter::match(const char *name) const
+{
+	Match m;
+	size_t n = 0;
+	const char *c = name;
+
+	while (true) {
+		const auto &node = this->trie_[n];
+		m.pos_ |= node.pos_;
+		m.neg_ |= node.neg_;
+
+		if (*c == '\0') {
+			break;
+		}
+
+		auto it = node.next_.find(*c);
+		if (it == node.next_.end()) {
+			break;
+		}
+
+		n = it->second;
+		c++;
+	}
+
+	for (const auto &g : this->globs_) {
+		if ((g.neg_ ? !m.neg_ : !m.pos_) && globMatch(g.pat_, name)) {
+			m.pos_ |= !g.neg_;
+			m.neg_ |= g.neg_;
+		}
+	}
+
+	for (const auto &r : this->regexes_) {
+		if ((r.neg_ ? !m.neg_ : !m.pos_) && std::regex_match(name, r.re_)) {
+			m.pos_ |= !r.neg_;
+			m.neg_ |= r.neg_;
+		}
+	}
+
+	return m;
+}
+
+bool Filter::selects(const char *name) const
+{
+	auto m = this->match(name);
+	return !m.neg_ && (m.pos_ || !this->has_pos_);
+}
+
+bool Filter::mayMatch(const char *name) const
+{
+	bool pos = false;
+	size_t n = 0;
+	const char *c = name;
+
+	while (true) {
+		const auto &node = this->trie_[n];
+
+		// Every iteration's name starts with the test's name, so a negative
+		// prefix excludes all of them.
+		if (node.neg_) {
+			return false;
+		}
+
+		pos |= node.pos_;
+
+		if (*c == '\0') {
+			// Filters like "test:1" select a single iteration
+			auto it = node.next_.find(':');
+			if (it != node.next_.end()) {
+				const auto &iter = this->trie_[it->second];
+				pos |= iter.pos_ || iter.pos_below_;
+			}
+
+			break;
+		}
+
+		auto it = node.next_.find(*c);
+		if (it == node.next_.end()) {
+			break;
+		}
+
+		n = it->second;
+		c++;
+	}
+
+	// Iterations have different names than their tests, so there's no telling
+	// if globs and regexes match them until they're created.
+	for (const auto &g : this->globs_) {
+		pos |= !g.neg_;
+	}
+
+	for (const auto &r : this->regexes_) {
+		pos |= !r.neg_;
+	}
+
+	return pos || !this->has_pos_;
+}
+}
@@ -0,0 +1,118 @@
+/**
+ * @file
+ * @author Andrew Stone <a@stoney.io>
+ * @copyright 2016 Andrew Stone
+ *
+ * This file is part of paratec and is released under the MIT License:
+ * http://opensource.org/licenses/MIT
+ */
+
+#pragma once
+#include <map>
+#include <regex>
+#include <string>
+#include <vector>
+#include "std.hpp"
+
+namespace pt
+{
+
+/**
+ * Test name filters, compiled once, when given. Plain filters match on name
+ * prefix and all live in a single trie, so checking a name against all of
+ * them is linear in the length of the name. Filters containing any of `*?[`
+ * are globs, and filters wrapped in slashes (`/like this/`) are regexes;
+ * both must match the entire name. Globs and regexes aren't combined into
+ * anything: each name is checked against them one at a time, so matching is
+ * linear in how many of them there are, though positive ones are skipped
+ * once something positive matched, and negative ones once something negative
+ * did.
+ */
+class Filter
+{
+	struct Node {
+		std::map<char, size_t> next_;
+
+		/**
+		 * A positive/negative filter ends here
+		 */
+		bool pos_ = false;
+		bool neg_ = false;
+
+		/**
+		 * Some positive filter ends below this node
+		 */
+		bool pos_below_ = false;
+	};
+
+	struct Glob {
+		bool neg_;
+		std::string pat_;
+	};
+
+	struct Regex {
+		bool neg_;
+		std::regex re_;
+	};
+
+	std::vector<Node> trie_{ 1 };
+	std::vector<Glob> globs_;
+	std::vector<Regex> regexes_;
+
+	bool has_pos_ = false;
+	size_t count_ = 0;
+
+	void addPrefix(bool neg, const std::string &f);
+
+	static bool globMatch(const std::string &pat, const char *name);
+
+public:
+	/**
+	 * What matched a name
+	 */
+	struct Match {
+		bool pos_ = false;
+		bool neg_ = false;
+	};
+
+	/**
+	 * Compile and add a filter
+	 */
+	void add(bool neg, std::string f);
+
+	/**
+	 * Number of filters added
+	 */
+	inline size_t size() const
+	{
+		return this->count_;
+	}
+
+	/**
+	 * If any positive filters were given. When they are, only names that
+	 * match one of them are selected.
+	 */
+	inline bool hasPositive() const
+	{
+		return this->has_pos_;
+	}
+
+	/**
+	 * Check the name against every filter
+	 */
+	Match match(const char *name) const;
+
+	/**
+	 * If the name is selected by the filters: not matched by any negative
+	 * filter, and matched by a positive one, if there are any.
+	 */
+	bool selects(const char *name) const;
+
+	/**
+	 * If the given test, or any of its iterations, could be selected by the
+	 * filters. This only looks at the test's name, so it may return true
+	 * for tests that are then disabled.
+	 */
+	bool mayMatch(const char *name) const;
+};
+}
@@ -0,0 +1,110 @@
+/**
+ * @author Andrew Stone <a@stoney.io>
+ * @copyright 2016 Andrew Stone
+ *
+ * This file is part of paratec and is released under the MIT License:
+ * http://opensource.org/licenses/MIT
+ */
+
+#include "filter.hpp"
+#include "opts.hpp"
+#include "util_test.hpp"
+
+namespace pt
+{
+
+static struct {
+	const char *filt_;
+	const char *name_;
+	bool selects_;
+} _filterSelects[] = {
+	{ "abc", "abc", true },
+	{ "abc", "abcd", true },
+	{ "abc", "ab", false },
+	{ "abc,-abcd", "abcd", false },
+	{ "abc,-abcd", "abce", true },
+	{ "-abc", "xyz", true },
+	{ "-abc", "abc:1", false },
+	{ "a*c", "abc", true },
+	{ "a*c", "abcd", false },
+	{ "a*c", "ac", true },
+	{ "*_slow", "net_slow", true },
+	{ "*_slow", "net_slow_not", false },
+	{ "-*_slow", "net_slow", false },
+	{ "-*_slow", "net_fast", true },
+	{ "a?c", "abc", true },
+	{ "a?c", "ac", false },
+	{ "a[bx]c", "axc", true },
+	{ "a[bx]c", "ayc", false },
+	{ "a[!bx]c", "ayc", true },
+	{ "a[a-c]c", "abc", true },
+	{ "a[a-c]c", "adc", false },
+	{ "a[]]c", "a]c", true },
+	{ "a*b*c", "aXbYbZc", true },
+	{ "a*b*c", "aXbYbZ", false },
+	{ "/ab+c/", "abbbc", true },
+	{ "/ab+c/", "abbbcd", false },
+	{ "/ab+c/", "xabc", false },
+	{ "/a{1,2}/", "aa", true },
+	{ "/a{1,2}/,abc", "abc", true },
+	{ "-/x.*/", "xyz", false },
+	{ "-/x.*/", "abc", true },
+	{ "test:1", "test:1", true },
+	{ "test:1", "test:2", false },
+};
+
+TESTV(filterSelects, _filterSelects)
+{
+	Opts opts;
+	opts.parse({ "paratec", "-f", _t->filt_ });
+
+	pt(opts.filter_.get().selects(_t->name_) == _t->selects_,
+	   "expected `%s` to %sselect `%s`", _t->filt_, _t->selects_ ? "" : "not ",
+	   _t->name_);
+
+	if (_t->selects_) {
+		pt(opts.filter_.get().mayMatch(_t->name_));
+	}
+}
+
+TEST(filterMayMatchIter)
+{
+	Filter f;
+	f.add(false, "test:1");
+
+	pt(f.mayMatch("test"));
+	pt(!f.mayMatch("tes"));
+	pt(!f.mayMatch("other"));
+}
+
+TEST(filterRegexCommas)
+{
+	Opts opts;
+	opts.parse({ "paratec", "-f", "/a{1,2}/, -b" });
+
+	pt_eq(opts.filter_.get().size(), (size_t)2);
+	pt(opts.filter_.get().selects("aa"));
+	pt(!opts.filter_.get().selects("aaa"));
+}
+
+TEST(filterInvalidRegex, PTEXIT(1))
+{
+	Opts opts;
+	opts.parse({ "paratec", "-f", "/a(/" });
+}
+
+TEST(filterMany)
+{
+	int i;
+	Filter f;
+
+	for (i = 0; i < 1000; i++) {
+		f.add(true, "quarantined_" + std::to_string(i));
+	}
+
+	pt(!f.selects("quarantined_500"));
+	pt(!f.selects("quarantined_5001"));
+	pt(f.selects("quarantined_"));
+	pt(f.selects("other"));
+}
+}
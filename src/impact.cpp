@@ -0,0 +1,358 @@
+/**
+ * @author Andrew Stone <a@stoney.io>
+ * @copyright 2016 Andrew Stone
+ *
+ * This file is part of paratec and is released under the MIT License:
+ * http://opensource.org/licenses/MIT
+ */
+
+#include <dlfcn.h>
+#include <fstream>
+#include <sstream>
+#include <string.h>
+#include <unistd.h>
+#include "err.hpp"
+#include "fork.hpp"
+#include "impact.hpp"
+#include "paratec.h"
+
+#ifdef PT_LINUX
+#include <elf.h>
+#include <link.h>
+#endif
+
+namespace pt
+{
+namespace impact
+{
+
+/**
+ * How many addresses to give each run of addr2line
+ */
+static constexpr size_t kResolveBatch = 512;
+
+/**
+ * How far to probe for a free slot before giving up
+ */
+static constexpr size_t kMaxProbe = 64;
+
+/**
+ * Only ever set in forked tests
+ */
+static std::atomic<Footprint *> _active{ nullptr };
+
+void Footprint::reset()
+{
+	for (auto &s : this->slots_) {
+		s.store(0, std::memory_order_relaxed);
+	}
+
+	this->count_ = 0;
+	this->full_ = false;
+}
+
+__attribute__((no_instrument_function)) void Footprint::add(uintptr_t fn)
+{
+	size_t probe;
+	size_t i = (fn * 0x9e3779b97f4a7c15) >> (64 - 16);
+
+	if (this->full_.load(std::memory_order_relaxed)) {
+		return;
+	}
+
+	for (probe = 0; probe < kMaxProbe; probe++) {
+		auto &slot = this->slots_[(i + probe) % kSlots];
+		auto cur = slot.load(std::memory_order_relaxed);
+
+		if (cur == fn) {
+			return;
+		}
+
+		if (cur == 0) {
+			if (slot.compare_exchange_strong(cur, fn)) {
+				if (this->count_.fetch_add(1) >= kSlots / 4 * 3) {
+					this->full_ = true;
+				}
+
+				return;
+			}
+
+			// Someone else just took the slot: maybe for the same function
+			if (cur == fn) {
+				return;
+			}
+		}
+	}
+
+	this->full_ = true;
+}
+
+std::vector<uintptr_t> Footprint::get() const
+{
+	std::vector<uintptr_t> fns;
+
+	for (const auto &s : this->slots_) {
+		auto fn = s.load(std::memory_order_relaxed);
+		if (fn != 0) {
+			fns.push_back(fn);
+		}
+	}
+
+	return fns;
+}
+
+void record(Footprint *fp)
+{
+	_active.store(fp);
+}
+
+Map Map::load(const std::string &path)
+{
+	Map m;
+	std::string line;
+	std::ifstream f(path);
+
+	while (std::getline(f, line)) {
+		std::string field;
+		std::istringstream is(line);
+
+		if (!std::getline(is, field, '\t') || field.size() == 0) {
+			continue;
+		}
+
+		auto &files = m.tests_[field];
+		while (std::getline(is, field, '\t')) {
+			files.insert(field);
+		}
+	}
+
+	return m;
+}
+
+void Map::write(const std::string &path) const
+{
+	std::ofstream f(path, std::ios::trunc);
+	if (!f.good()) {
+		OSErr(-1, {}, "failed to open impact map %s", path.c_str());
+	}
+
+	for (const auto &t : this->tests_) {
+		f << t.first;
+		for (const auto &file : t.second) {
+			f << '\t' << file;
+		}
+		f << '\n';
+	}
+
+	f.flush();
+	if (!f.good()) {
+		OSErr(-1, {}, "failed to write impact map %s", path.c_str());
+	}
+}
+
+void Map::set(const std::string &test, std::set<std::string> files)
+{
+	this->tests_[test] = std::move(files);
+}
+
+void Map::setAll(const std::string &test)
+{
+	this->tests_[test] = { kAll };
+}
+
+static bool _endsWith(const std::string &s, const std::string &end)
+{
+	return s.size() > end.size() && s[s.size() - end.size() - 1] == '/'
+		   && s.compare(s.size() - end.size(), end.size(), end) == 0;
+}
+
+bool Map::affected(const std::string &test,
+				   const std::vector<std::string> &changed) const
+{
+	auto it = this->tests_.find(test);
+	if (it == this->tests_.end() || it->second.count(kAll) > 0) {
+		return true;
+	}
+
+	for (const auto &c : changed) {
+		for (const auto &f : it->second) {
+			if (f == c || _endsWith(f, c) || _endsWith(c, f)) {
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+void Recorder::add(const std::string &test, const Footprint *fp)
+{
+	if (fp == nullptr || fp->full_) {
+		this->all_.insert(test);
+		return;
+	}
+
+	auto &fns = this->fns_[test];
+	for (auto fn : fp->get()) {
+		fns.insert(fn);
+	}
+}
+
+/**
+ * addr2line wants addresses in executables as they are, and addresses in
+ * shared objects (and PIEs) relative to where they were loaded.
+ */
+static bool _isExec(const std::string &obj)
+{
+#ifdef PT_LINUX
+	ElfW(Ehdr) eh;
+	std::ifstream f(obj, std::ios::binary);
+
+	return f.read((char *)&eh, sizeof(eh)) && eh.e_type == ET_EXEC;
+#else
+	(void)obj;
+	return false;
+#endif
+}
+
+/**
+ * Resolve addresses in the object to the source files they're from
+ */
+static void _resolve(const std::string &obj,
+					 const std::vector<std::pair<uintptr_t, uintptr_t>> &addrs,
+					 std::map<uintptr_t, std::string> *files)
+{
+	size_t i;
+
+	for (i = 0; i < addrs.size(); i += kResolveBatch) {
+		auto end = std::min(addrs.size(), i + kResolveBatch);
+		std::vector<std::string> args{ "addr2line", "-e", obj };
+
+		for (auto j = i; j < end; j++) {
+			char buff[32];
+			snprintf(buff, sizeof(buff), "0x%zx", (size_t)addrs[j].second);
+			args.push_back(buff);
+		}
+
+		Fork f;
+		auto e = f.run([&]() {
+			std::vector<char *> argv;
+			for (const auto &a : args) {
+				argv.push_back(const_cast<char *>(a.c_str()));
+			}
+			argv.push_back(nullptr);
+
+			execvp(argv[0], argv.data());
+
+			fprintf(stderr, "failed to exec addr2line: %s\n", strerror(errno));
+			_exit(127);
+		});
+
+		if (e.status_ != 0 || e.signal_ != 0) {
+			Err(-1, "failed to resolve functions in %s: %s", obj.c_str(),
+				e.stderr_.c_str());
+		}
+
+		std::string line;
+		std::istringstream is(e.stdout_);
+		for (auto j = i; j < end && std::getline(is, line); j++) {
+			// Lines look like "file:line (discriminator n)"
+			line = line.substr(0, line.find(" ("));
+			line = line.substr(0, line.rfind(':'));
+
+			if (line.size() > 0 && line != "??") {
+				(*files)[addrs[j].first] = line;
+			}
+		}
+	}
+}
+
+void Recorder::save(const std::string &path) const
+{
+	size_t recorded = 0;
+	std::map<uintptr_t, std::string> files;
+	std::map<std::string, std::vector<std::pair<uintptr_t, uintptr_t>>> objs;
+
+	for (const auto &t : this->fns_) {
+		for (auto fn : t.second) {
+			Dl_info info;
+
+			recorded++;
+
+			if (files.count(fn) > 0 || dladdr((void *)fn, &info) == 0) {
+				continue;
+			}
+
+			std::string obj = info.dli_fname;
+			if (obj.size() == 0 || access(obj.c_str(), R_OK) != 0) {
+				obj = "/proc/self/exe";
+			}
+
+			auto rel = _isExec(obj) ? fn : fn - (uintptr_t)info.dli_fbase;
+			objs[obj].push_back({ fn, rel });
+			files[fn] = "";
+		}
+	}
+
+	if (recorded == 0 && this->fns_.size() > 0) {
+		Err(-1, "no functions were recorded: was the code under test built "
+				"with -finstrument-functions?");
+	}
+
+	for (const auto &o : objs) {
+		_resolve(o.first, o.second, &files);
+	}
+
+	auto m = Map::load(path);
+
+	for (const auto &t : this->fns_) {
+		bool all = false;
+		std::set<std::string> srcs;
+
+		for (auto fn : t.second) {
+			auto it = files.find(fn);
+
+			// Code that can't be found can't be ruled out
+			if (it == files.end() || it->second.size() == 0) {
+				all = true;
+				break;
+			}
+
+			srcs.insert(it->second);
+		}
+
+		if (all) {
+			m.setAll(t.first);
+		} else {
+			m.set(t.first, std::move(srcs));
+		}
+	}
+
+	for (const auto &t : this->all_) {
+		m.setAll(t);
+	}
+
+	m.write(path);
+}
+}
+}
+
+extern "C" {
+
+/**
+ * Called on entry to every function compiled with -finstrument-functions
+ */
+__attribute__((no_instrument_function)) void
+__cyg_profile_func_enter(void *fn, void *)
+{
+	auto fp = pt::impact::_active.load(std::memory_order_relaxed);
+	if (fp != nullptr) {
+		fp->add((uintptr_t)fn);
+	}
+}
+
+__attribute__((no_instrument_function)) void __cyg_profile_func_exit(void *,
+																	 void *)
+{
+}
+}
@@ -0,0 +1,129 @@
+/**
+ * @file
+ * @author Andrew Stone <a@stoney.io>
+ * @copyright 2016 Andrew Stone
+ *
+ * This file is part of paratec and is released under the MIT License:
+ * http://opensource.org/licenses/MIT
+ */
+
+#pragma once
+#include <atomic>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include "std.hpp"
+
+namespace pt
+{
+namespace impact
+{
+
+/**
+ * Every function a test called. Code compiled with -finstrument-functions
+ * calls into paratec on entry to every function; while a footprint is
+ * recording, each function is added to it. Footprints live in memory shared
+ * with the parent, so there's nothing to collect from the test once it exits.
+ */
+struct Footprint {
+	static constexpr size_t kSlots = 1 << 16;
+
+	/**
+	 * An open-addressed set of function addresses; 0 is an empty slot.
+	 * Filled from any thread the test runs.
+	 */
+	std::atomic<uintptr_t> slots_[kSlots];
+	std::atomic<size_t> count_;
+
+	/**
+	 * When the test called too many functions to remember, it has to be
+	 * assumed to depend on everything.
+	 */
+	std::atomic<bool> full_;
+
+	/**
+	 * Clear out anything from the last test
+	 */
+	void reset();
+
+	void add(uintptr_t fn);
+
+	std::vector<uintptr_t> get() const;
+};
+
+/**
+ * Start adding every function called in this process to the footprint.
+ */
+void record(Footprint *fp);
+
+/**
+ * Which source files each test depends on
+ */
+class Map
+{
+	/**
+	 * Tests that depend on every file
+	 */
+	static constexpr const char *kAll = "*";
+
+	std::map<std::string, std::set<std::string>> tests_;
+
+public:
+	/**
+	 * Read a map written by write(). A missing file is an empty map.
+	 */
+	static Map load(const std::string &path);
+
+	void write(const std::string &path) const;
+
+	/**
+	 * Set the files the test depends on
+	 */
+	void set(const std::string &test, std::set<std::string> files);
+
+	/**
+	 * Set the test to depend on every file
+	 */
+	void setAll(const std::string &test);
+
+	/**
+	 * If the test depends on any of the changed files. Tests that aren't in
+	 * the map have never been recorded, so they might depend on anything.
+	 * Changed files match files in the map that end with them, so paths
+	 * relative to a project's root find files compiled with absolute paths.
+	 */
+	bool affected(const std::string &test,
+				  const std::vector<std::string> &changed) const;
+};
+
+/**
+ * Collects the footprints of tests, resolving them to source files once
+ * they've all run.
+ */
+class Recorder
+{
+	std::map<std::string, std::set<uintptr_t>> fns_;
+	std::set<std::string> all_;
+
+public:
+	/**
+	 * Add the test's footprint. Without a footprint, the test is assumed
+	 * to depend on everything.
+	 */
+	void add(const std::string &test, const Footprint *fp);
+
+	/**
+	 * Update the map at the given path with the tests recorded. Functions
+	 * are resolved to their source files from their debug info, with
+	 * addr2line.
+	 */
+	void save(const std::string &path) const;
+};
+}
+}
+
+extern "C" {
+void __cyg_profile_func_enter(void *fn, void *site);
+void __cyg_profile_func_exit(void *fn, void *site);
+}
@@ -0,0 +1,131 @@
+/**
+ * @author Andrew Stone <a@stoney.io>
+ * @copyright 2016 Andrew Stone
+ *
+ * This file is part of paratec and is released under the MIT License:
+ * http://opensource.org/licenses/MIT
+ */
+
+#include <algorithm>
+#include "impact.hpp"
+#include "main.hpp"
+#include "util.hpp"
+#include "util_test.hpp"
+
+namespace pt
+{
+
+static void _impactCalled()
+{
+}
+
+TEST(_impactCalls)
+{
+	// As if this file had been built with -finstrument-functions
+	__cyg_profile_func_enter((void *)_impactCalled, nullptr);
+	_impactCalled();
+}
+
+TEST(_impactNothing)
+{
+}
+
+TEST(impactFootprint)
+{
+	SharedMem<impact::Footprint> fp;
+	fp->reset();
+
+	fp->add(0x1000);
+	fp->add(0x2000);
+	fp->add(0x1000);
+
+	auto fns = fp->get();
+	std::sort(fns.begin(), fns.end());
+
+	pt_eq(fns.size(), (size_t)2);
+	pt_eq(fns[0], (uintptr_t)0x1000);
+	pt_eq(fns[1], (uintptr_t)0x2000);
+	pt(!fp->full_);
+
+	fp->reset();
+	pt_eq(fp->get().size(), (size_t)0);
+}
+
+TEST(impactMap)
+{
+	char path[] = "/tmp/paratec-impact-XXXXXX";
+	int fd = mkstemp(path);
+	pt(fd >= 0);
+	close(fd);
+
+	DTor d([&]() { unlink(path); });
+
+	impact::Map m;
+	m.set("a", { "/src/proj/lib/a.c", "/src/proj/lib/util.h" });
+	m.set("b", { "lib/b.c" });
+	m.setAll("c");
+	m.write(path);
+
+	auto l = impact::Map::load(path);
+
+	pt(l.affected("a", { "lib/a.c" }));
+	pt(l.affected("a", { "other.c", "util.h" }));
+	pt(!l.affected("a", { "a.c.orig" }));
+	pt(!l.affected("a", { "b/a.c" }));
+	pt(l.affected("b", { "/src/proj/lib/b.c" }));
+	pt(!l.affected("b", { "lib/a.c" }));
+	pt(l.affected("c", { "anything.c" }));
+
+	// Never recorded
+	pt(l.affected("d", { "anything.c" }));
+}
+
+TEST(impactRecord)
+{
+	char dir[] = "/tmp/paratec-impact-XXXXXX";
+	pt(mkdtemp(dir) != nullptr);
+
+	auto path = std::string(dir) + "/map";
+	DTor d([&]() {
+		unlink(path.c_str());
+		rmdir(dir);
+	});
+
+	std::string iarg("--impact=" + path);
+	auto tests = [] {
+		return std::vector<sp<const Test>>{
+			MKTEST(_impactCalls), MKTEST(_impactNothing),
+		};
+	};
+
+	{
+		std::stringstream out;
+		Main m(tests());
+		auto rslts = m.run(out, { "paratec", iarg.c_str(), "--record-impact" });
+		pt_eq(rslts.exitCode(), 0);
+	}
+
+	auto map = impact::Map::load(path);
+	pt(map.affected("_impactCalls", { "src/impact_test.cpp" }));
+	pt(!map.affected("_impactCalls", { "src/impact.cpp" }));
+	pt(!map.affected("_impactNothing", { "src/impact_test.cpp" }));
+
+	{
+		std::stringstream out;
+		Main m(tests());
+		auto rslts = m.run(out, { "paratec", iarg.c_str(), "-v",
+								  "--changed-files=src/impact_test.cpp" });
+
+		pt_in("of 1 tests run, 1 OK", out.str());
+		pt_in("PASS : _impactCalls", out.str());
+	}
+}
+
+TEST(impactNeedsMap, PTEXIT(1))
+{
+	std::stringstream out;
+
+	Main m(std::vector<sp<const Test>>{});
+	m.run(out, { "paratec", "--changed-files=a.c" });
+}
+}
@@ -6,12 +6,19 @@
  * http://opensource.org/licenses/MIT
  */
 
+#include <algorithm>
+#include <alloca.h>
+#include <random>
+#include <signal.h>
 #include <stack>
+#include <string.h>
 #include <sys/file.h>
 #include <sys/wait.h>
 #include "err.hpp"
 #include "jobs.hpp"
+#include "leaks.hpp"
 #include "signal.hpp"
+#include "stats.hpp"
 #include "time.hpp"
 
 namespace pt
@@ -22,6 +29,13 @@ namespace pt
  */
 static std::string _bin;
 
+/**
+ * Calibrated once, before forking, so that every benchmark uses the same
+ * calibration. Without forking, there are no Jobs, so the first benchmark
+ * calibrates it.
+ */
+static sp<const time::BenchTimer> _timer;
+
 /**
  * Stack of active jobs. It's possible for non-forking tests to run other non-
  * forking tests.
@@ -62,10 +76,18 @@ static uint32_t _roundUp(uint32_t n)
 	return 10 * base;
 }
 
+time::duration Job::benchRound(uint32_t n, size_t variant)
+{
+	if (this->evict_ != nullptr) {
+		this->evict_->evict();
+	}
+
+	return this->test_->bench(n, *_timer, this->prof_.get(), variant);
+}
+
 // This was pretty much lifted from Golang's benchmarking
-void Job::runBench()
+uint32_t Job::benchScale(time::duration target, size_t variant)
 {
-	const auto max_dur = time::toDuration(this->opts_->bench_dur_.get());
 	static constexpr uint32_t kMmaxBenchIters = 1000000000;
 
 	uint32_t n = 1;
@@ -74,16 +96,20 @@ void Job::runBench()
 	uint64_t ns_op = 0;
 	time::duration dur{ 0 };
 
-	while (n < kMmaxBenchIters && dur < max_dur) {
+	if (this->evict_ != nullptr) {
+		return this->benchCold(target, variant);
+	}
+
+	while (n < kMmaxBenchIters && dur < target) {
 		last_n = n;
 
-		dur = this->test_->bench(n);
+		dur = this->benchRound(n, variant);
 		ns_op = time::toNanoSeconds(dur) / n;
 
 		if (ns_op == 0) {
 			n = kMmaxBenchIters;
 		} else {
-			n = (uint32_t)(time::toNanoSeconds(max_dur) / ns_op);
+			n = (uint32_t)(time::toNanoSeconds(target) / ns_op);
 		}
 
 		n = std::max(std::min(n + n / 5, 100 * last_n), last_n + 1);
@@ -92,6 +118,279 @@ void Job::runBench()
 
 	this->sj_->env_->bench_iters_ = last_n;
 	this->sj_->env_->bench_ns_op_ = ns_op;
+
+	return last_n;
+}
+
+uint32_t Job::benchCold(time::duration target, size_t variant)
+{
+	static constexpr size_t kMinRounds = 10;
+
+	size_t round;
+	std::vector<double> ns_ops;
+	auto start = time::now();
+
+	// Only the first iteration of a round runs with cold caches, so every
+	// round is just 1 iteration.
+	for (round = 0; round < kMinRounds || time::now() - start < target;
+		 round++) {
+		auto dur = this->benchRound(1, variant);
+		ns_ops.push_back((double)time::toNanoSeconds(dur));
+	}
+
+	this->sj_->env_->bench_iters_ = round;
+	this->sj_->env_->bench_ns_op_ = (uint64_t)stats::mean(ns_ops);
+
+	return 1;
+}
+
+void Job::benchCompare(time::duration max_dur)
+{
+	static constexpr size_t kMinRounds = 10;
+	static constexpr size_t kMaxRounds = 10000;
+
+	size_t i;
+	size_t round;
+	auto env = this->sj_->env_;
+	const auto &vars = this->test_->variants();
+	const auto nvars = vars.size();
+
+	if (nvars > TestEnv::kMaxVariants) {
+		_pt_fail("PTCMP may compare at most %d variants, got %zu",
+				 TestEnv::kMaxVariants, nvars);
+	}
+
+	// Scale on the baseline so that every variant runs the same number of
+	// iterations per round, with enough rounds to fit in the time budget.
+	uint32_t n = 1;
+	if (this->evict_ == nullptr) {
+		n = this->benchScale(max_dur / (kMinRounds * nvars), 0);
+	}
+
+	std::vector<std::vector<double>> ns_ops(nvars);
+	auto start = time::now();
+
+	for (round = 0; round < kMinRounds
+					|| (round < kMaxRounds && time::now() - start < max_dur);
+		 round++) {
+		for (i = 0; i < nvars; i++) {
+			// Reverse the order every other round so that no variant always
+			// runs directly after another.
+			auto v = round % 2 == 0 ? i : nvars - 1 - i;
+			auto dur = this->benchRound(n, v);
+			ns_ops[v].push_back((double)time::toNanoSeconds(dur) / n);
+		}
+	}
+
+	env->bench_iters_ = n;
+	env->bench_rounds_ = round;
+	env->bench_ns_op_ = (uint64_t)stats::mean(ns_ops[0]);
+
+	for (i = 0; i < nvars; i++) {
+		std::vector<double> speedups;
+
+		for (round = 0; round < ns_ops[i].size(); round++) {
+			if (ns_ops[i][round] > 0) {
+				speedups.push_back(ns_ops[0][round] / ns_ops[i][round]);
+			}
+		}
+
+		env->bench_var_ns_op_[i] = stats::mean(ns_ops[i]);
+		env->bench_var_speedup_[i] = stats::mean(speedups);
+		env->bench_var_ci_[i] = stats::ci95(speedups);
+	}
+}
+
+void Job::benchSweep(time::duration max_dur)
+{
+	size_t i;
+	auto env = this->sj_->env_;
+	auto tiers = cpu::tiers();
+
+	if (this->test_->variants().size() > 0) {
+		_pt_fail("PTSWEEP may not be combined with PTCMP");
+	}
+
+	tiers.resize(std::min(tiers.size(), (size_t)TestEnv::kMaxTiers));
+
+	for (i = 0; i < tiers.size(); i++) {
+		const auto &tier = tiers[i];
+
+		// The benchmark's state depends on the working set size, so it has
+		// to be rebuilt for every tier.
+		this->sj_->bench_wss_ = tier.size_;
+		this->sj_->bench_state_ = this->test_->benchSetup();
+
+		this->benchScale(max_dur, 0);
+
+		this->test_->benchTeardown(this->sj_->bench_state_);
+		this->sj_->bench_state_ = nullptr;
+
+		strncpy(env->bench_tier_name_[i], tier.name_,
+				sizeof(env->bench_tier_name_[i]) - 1);
+		env->bench_tier_wss_[i] = tier.size_;
+		env->bench_tier_ns_op_[i] = env->bench_ns_op_;
+		env->bench_tiers_ = i + 1;
+	}
+
+	this->sj_->bench_wss_ = 0;
+
+	// Report the fastest tier on the summary line
+	env->bench_ns_op_ = env->bench_tier_ns_op_[0];
+}
+
+void Job::benchOnce(bool profile)
+{
+	const auto max_dur = time::toDuration(this->opts_->bench_dur_.get());
+	const auto &cold = this->opts_->bench_cold_;
+
+	if (profile && this->opts_->bench_profile_.get().size() > 0) {
+		this->prof_ = mksp<Profiler>(this->opts_->bench_profile_.get(),
+									 this->test_->name());
+	}
+
+	if (cold.enabled()) {
+		this->evict_ = mksp<cpu::Evictor>(cold.tlb());
+	}
+
+	if (this->test_->sweeps()) {
+		this->benchSweep(max_dur);
+	} else {
+		this->sj_->bench_state_ = this->test_->benchSetup();
+
+		if (this->test_->variants().size() > 0) {
+			this->benchCompare(max_dur);
+		} else {
+			this->benchScale(max_dur, 0);
+		}
+
+		this->test_->benchTeardown(this->sj_->bench_state_);
+		this->sj_->bench_state_ = nullptr;
+	}
+
+	if (this->prof_ != nullptr) {
+		this->prof_->write();
+	}
+
+	this->prof_.reset();
+	this->evict_.reset();
+}
+
+void Job::abandonBench()
+{
+	if (this->prof_ != nullptr) {
+		this->prof_->stop();
+	}
+
+	this->prof_.reset();
+	this->evict_.reset();
+}
+
+void Job::benchLayout(size_t stack_pad, size_t heap_pad, bool profile)
+{
+	// Everything the benchmark puts on the stack now lands stack_pad bytes
+	// further down.
+	auto pad = (volatile char *)alloca(stack_pad + 1);
+	pad[0] = 0;
+
+	// Shift everything the benchmark allocates. This is never freed: the
+	// process exits as soon as the benchmark is done.
+	volatile auto heap = malloc(heap_pad + 1);
+	(void)heap;
+
+	this->benchOnce(profile);
+	this->sj_->exit(0);
+}
+
+void Job::benchLayouts(uint layouts)
+{
+	static constexpr size_t kMaxStackPad = 4096;
+	static constexpr size_t kMaxHeapPad = 64 * 1024;
+
+	uint l;
+	uint64_t i;
+	auto env = this->sj_->env_;
+	const auto nvars = this->test_->variants().size();
+
+	std::random_device rd;
+	std::mt19937_64 rng(rd());
+	std::uniform_int_distribution<size_t> stack(0, kMaxStackPad / 16);
+	std::uniform_int_distribution<size_t> heap(0, kMaxHeapPad / 16);
+
+	uint64_t rounds = 0;
+	std::vector<double> ns_ops;
+	std::vector<std::vector<double>> var_ns_ops(nvars);
+	std::vector<std::vector<double>> var_speedups(nvars);
+	std::vector<std::vector<double>> tier_ns_ops(TestEnv::kMaxTiers);
+
+	for (l = 0; l < layouts; l++) {
+		Fork f;
+
+		// Keep the stack 16-byte aligned, as the ABI requires.
+		auto stack_pad = stack(rng) * 16;
+		auto heap_pad = heap(rng) * 16;
+
+		// The same file would just be overwritten by every layout, so only
+		// profile the first.
+		auto e = f.run([&]() { this->benchLayout(stack_pad, heap_pad, l == 0); });
+
+		fwrite(e.stdout_.data(), 1, e.stdout_.size(), stdout);
+		fwrite(e.stderr_.data(), 1, e.stderr_.size(), stderr);
+
+		if (e.signal_ != 0) {
+			signal(e.signal_, SIG_DFL);
+			raise(e.signal_);
+		}
+
+		if (e.status_ != 0 || env->failed_) {
+			this->sj_->exit(e.status_ ?: 1);
+		}
+
+		rounds += env->bench_rounds_;
+		ns_ops.push_back((double)env->bench_ns_op_);
+
+		for (i = 0; i < nvars; i++) {
+			var_ns_ops[i].push_back(env->bench_var_ns_op_[i]);
+			var_speedups[i].push_back(env->bench_var_speedup_[i]);
+		}
+
+		for (i = 0; i < env->bench_tiers_; i++) {
+			tier_ns_ops[i].push_back((double)env->bench_tier_ns_op_[i]);
+		}
+	}
+
+	// Each layout is an independent sample, so the spread between them is
+	// exactly the noise that layout luck adds.
+	env->bench_layouts_ = layouts;
+	env->bench_layout_sd_ = stats::stddev(ns_ops);
+	env->bench_ns_op_ = (uint64_t)stats::mean(ns_ops);
+	env->bench_rounds_ = rounds;
+
+	for (i = 0; i < nvars; i++) {
+		env->bench_var_ns_op_[i] = stats::mean(var_ns_ops[i]);
+		env->bench_var_speedup_[i] = stats::mean(var_speedups[i]);
+		env->bench_var_ci_[i] = stats::ci95(var_speedups[i]);
+	}
+
+	for (i = 0; i < env->bench_tiers_; i++) {
+		env->bench_tier_ns_op_[i] = (uint64_t)stats::mean(tier_ns_ops[i]);
+	}
+}
+
+void Job::runBench()
+{
+	const auto layouts = this->opts_->bench_layouts_.get();
+
+	if (_timer == nullptr) {
+		_timer = mksp<time::BenchTimer>(this->opts_->bench_timer_.tsc());
+	}
+
+	// Without forking, there's nowhere to put the layouts.
+	if (layouts > 1 && this->opts_->fork_) {
+		this->benchLayouts(layouts);
+	} else {
+		this->benchOnce(true);
+	}
 }
 
 bool Job::prep(sp<const Test> test)
@@ -106,6 +405,12 @@ bool Job::prep(sp<const Test> test)
 		return false;
 	}
 
+	if (this->rslts_->fromCache(*this->test_, &this->res_)) {
+		this->recordResult();
+		this->test_ = nullptr;
+		return false;
+	}
+
 	this->start_ = time::now();
 
 	return true;
@@ -173,6 +478,8 @@ bool BasicJob::run(sp<const Test> test)
 		printf("%s\n", head.c_str());
 		printf("%s\n\n", underline.c_str());
 		this->execute();
+	} else {
+		this->abandonBench();
 	}
 
 	this->finish();
@@ -187,30 +494,66 @@ bool BasicJob::run(sp<const Test> test)
 void ForkingSharedJob::_exit(int status)
 {
 	/*
-	 * LLVM's cov is not fork-safe. So if forking and running with llvm cov,
-	 * then need to make sure that only 1 process is writing coverage data at
-	 * a time: flock is magic for this. With flock, the lock is released when
-	 * the process exits (awesome), and it serves as a lock (awesome).
+	 * Some coverage runtimes aren't fork-safe: they can corrupt their output
+	 * when 2 processes write it at the same time. When asked, make sure that
+	 * only 1 process is writing coverage data at a time: flock is magic for
+	 * this. With flock, the lock is released when the process exits
+	 * (awesome), and it serves as a lock (awesome).
 	 *
 	 * @see https://llvm.org/bugs/show_bug.cgi?id=20986
 	 *
-	 * Don't worry about checking if running llvm's cov (that's platform
-	 * specific and painful); just flock everything. It won't make too much of
-	 * a difference since this is just preventing a very rare race condition.
+	 * Every forked test queues up behind the lock, so it's only taken when
+	 * asked for. gcov's runtime locks each file it writes, and LLVM profiles
+	 * are written to a file per test (see Coverage).
 	 */
-	int fd = open(_bin.c_str(), O_RDONLY);
-	OSErr(fd, {}, "failed to open paratec binary for reading");
-	flock(fd, LOCK_EX);
+	if (this->opts_->cov_lock_.get()) {
+		int fd = open(_bin.c_str(), O_RDONLY);
+		OSErr(fd, {}, "failed to open paratec binary for reading");
+		flock(fd, LOCK_EX);
+	}
 
 	::exit(status);
 }
 
+void ForkingJob::recordImpact(sp<impact::Recorder> recorder)
+{
+	this->recorder_ = std::move(recorder);
+	this->footprint_ = mksp<SharedMem<impact::Footprint>>();
+}
+
+void ForkingJob::collectCoverage(sp<Coverage> cov)
+{
+	this->cov_ = std::move(cov);
+}
+
+void ForkingJob::useCgroups(sp<Cgroups> cgroups)
+{
+	this->cgroups_ = std::move(cgroups);
+}
+
+void ForkingJob::pinTo(cpu::Slot slot)
+{
+	this->slot_ = mksp<cpu::Slot>(std::move(slot));
+}
+
 bool ForkingJob::run(sp<const Test> test)
 {
 	if (!this->prep(std::move(test))) {
 		return false;
 	}
 
+	if (this->footprint_ != nullptr) {
+		(*this->footprint_)->reset();
+	}
+
+	if (this->cgroups_ != nullptr) {
+		Cgroup::Limits limits;
+		limits.memory_max_ = this->test_->memoryMax();
+		limits.cpu_max_ = this->test_->cpuMax();
+		limits.pids_max_ = this->test_->pidsMax();
+		this->cg_ = this->cgroups_->make(limits);
+	}
+
 	this->fork_ = mksp<Fork>();
 
 	bool parent = this->fork_->fork(this->opts_->capture_, true);
@@ -225,7 +568,41 @@ bool ForkingJob::run(sp<const Test> test)
 	// and it doesn't matter.
 	_jobs.push(&this->sj_);
 
+	// Before anything else so that everything the test does is accounted for
+	if (this->cg_ != nullptr) {
+		this->cg_->enter();
+	}
+
+	// Tests that need more CPUs than the slot has are better off running
+	// wherever they can
+	if (this->slot_ != nullptr && !this->test_->serial_
+		&& (size_t)this->test_->cpus_ <= this->slot_->cpus_.size()) {
+		cpu::pin(*this->slot_);
+	}
+
+	if (this->footprint_ != nullptr) {
+		impact::record(this->footprint_->get());
+	}
+
+	if (this->cov_ != nullptr) {
+		this->cov_->child();
+	}
+
+	// Benchmarks allocate whatever they like between rounds, and remote tests
+	// are checked by the binary they run in
+	auto leaks = this->opts_->leaks_.get() && !this->test_->isBenchmark()
+				 && this->test_->remote() == nullptr;
+	if (leaks) {
+		leaks::start();
+	}
+
 	this->execute();
+
+	std::string leaked;
+	if (leaks && leaks::check(&leaked)) {
+		_pt_fail("%s", leaked.c_str());
+	}
+
 	this->sj_.exit(0);
 }
 
@@ -260,12 +637,35 @@ void ForkingJob::cleanup()
 		this->fork_->moveOuts(&this->res_.stdout_, &this->res_.stderr_);
 	}
 
+	// Remote tests run in another binary, where nothing can be seen
+	if (this->recorder_ != nullptr) {
+		this->recorder_->add(this->test_->name(),
+							 this->test_->remote() != nullptr
+								 ? nullptr
+								 : this->footprint_->get());
+	}
+
+	// Whatever the test left running dies with its cgroup
+	if (this->cg_ != nullptr) {
+		auto stats = this->cg_->stats();
+		this->res_.memory_peak_ = stats.memory_peak_;
+		this->res_.cpu_usec_ = stats.cpu_usec_;
+		this->cgroups_->release(std::move(this->cg_));
+	}
+
 	this->finish();
 	this->fork_ = nullptr;
 }
 
-void ForkingJob::cleanupStatus(int status)
+void ForkingJob::cleanupStatus(int status, const struct rusage &ru)
 {
+	// The one platform that went with bytes rather than KiB
+#ifdef PT_DARWIN
+	this->res_.max_rss_ = (uint64_t)ru.ru_maxrss;
+#else
+	this->res_.max_rss_ = (uint64_t)ru.ru_maxrss * 1024;
+#endif
+
 	if (WIFEXITED(status)) {
 		this->res_.exit_status_ = WEXITSTATUS(status);
 	} else if (WIFSIGNALED(status)) {
@@ -280,28 +680,208 @@ void ForkingJob::terminate()
 	if (this->fork_ != nullptr) {
 		this->fork_->terminate(nullptr);
 	}
+
+	if (this->cg_ != nullptr) {
+		this->cg_->kill();
+	}
+}
+
+void ForkingJob::cancel()
+{
+	if (this->test_ == nullptr) {
+		return;
+	}
+
+	this->terminate();
+	this->test_->cleanup();
+	this->rslts_->cancel(std::move(this->test_));
+
+	this->fork_ = nullptr;
+	if (this->cg_ != nullptr) {
+		this->cgroups_->release(std::move(this->cg_));
+	}
+}
+
+Jobs::Cost Jobs::cost(const Test &test) const
+{
+	Cost c;
+	const auto cpus = (uint)this->jobs_.size();
+
+	if (!test.enabled()) {
+		return c;
+	}
+
+	// A test can't ask for more than there is, or it would never run
+	c.cpus_ = test.serial_ ? cpus
+						   : std::min(cpus, (uint)std::max(test.cpus_, 1));
+
+	auto it = this->peaks_.find(test.name());
+	c.mem_ = it != this->peaks_.end() ? it->second : test.mem_;
+
+	for (const auto &res : test.resources()) {
+		c.res_.push_back(res.first);
+	}
+
+	return c;
+}
+
+bool Jobs::fits(const Cost &c) const
+{
+	const auto budget = this->opts_->mem_budget_.get();
+
+	// Anything that's too big for the budget still has to run sometime: it
+	// gets the machine to itself.
+	if (this->used_.cpus_ == 0) {
+		return true;
+	}
+
+	if (this->used_.cpus_ + c.cpus_ > this->limit_) {
+		return false;
+	}
+
+	for (const auto &res : c.res_) {
+		auto it = this->res_used_.find(res);
+		if (it != this->res_used_.end()
+			&& it->second >= this->res_limits_.at(res)) {
+			return false;
+		}
+	}
+
+	return budget == 0 || this->used_.mem_ + c.mem_ <= budget;
 }
 
-void Jobs::runNextTest(Job *job)
+bool Jobs::pending()
 {
-	while (this->testI_ < this->tests_.size()) {
-		auto i = this->testI_++;
-		auto test = this->tests_[i];
+	// The next round goes in as soon as the last one has all started, so
+	// replicas of a single test keep every job busy
+	if (this->tests_.size() == 0 && this->rslts_->repeat(this->rounds_)) {
+		this->rounds_++;
+
+		for (const auto &test : this->round_) {
+			this->rslts_->inc(true);
+			this->tests_.push_back(test);
+		}
+	}
+
+	return this->tests_.size() > 0;
+}
+
+void Jobs::runNextTest(size_t j)
+{
+	auto &job = this->jobs_[j];
+
+	// The first test that fits goes, so small tests backfill around big ones
+	auto it = this->tests_.begin();
+	while (it != this->tests_.end()) {
+		if (this->rslts_->abandoned(**it)) {
+			this->rslts_->cancel(std::move(*it));
+			it = this->tests_.erase(it);
+			continue;
+		}
+
+		auto c = this->cost(**it);
+		if (!this->fits(c)) {
+			++it;
+			continue;
+		}
 
-		if (job->run(std::move(test))) {
+		auto test = std::move(*it);
+		it = this->tests_.erase(it);
+
+		if (job.run(std::move(test))) {
+			this->used_.cpus_ += c.cpus_;
+			this->used_.mem_ += c.mem_;
+			for (const auto &res : c.res_) {
+				this->res_used_[res]++;
+			}
+
+			this->held_[j] = std::move(c);
 			return;
 		}
 	}
 }
 
+void Jobs::fill()
+{
+	size_t j;
+
+	// Everything that finished gives back what it held before anything new
+	// is let in
+	for (j = 0; j < this->jobs_.size(); j++) {
+		if (this->jobs_[j].pid() == -1) {
+			auto &held = this->held_[j];
+
+			this->used_.cpus_ -= held.cpus_;
+			this->used_.mem_ -= held.mem_;
+			for (const auto &res : held.res_) {
+				this->res_used_[res]--;
+			}
+
+			held = Cost();
+		}
+	}
+
+	if (this->rslts_->failingFast()) {
+		this->failFast();
+		return;
+	}
+
+	for (j = 0; j < this->jobs_.size() && this->pending(); j++) {
+		if (this->jobs_[j].pid() == -1) {
+			this->runNextTest(j);
+		}
+	}
+
+	// Never run out of tests between rounds, or the run looks done
+	this->pending();
+}
+
+void Jobs::failFast()
+{
+	for (auto &job : this->jobs_) {
+		job.cancel();
+	}
+
+	for (auto &test : this->tests_) {
+		this->rslts_->cancel(std::move(test));
+	}
+
+	this->tests_.clear();
+}
+
+void Jobs::adapt()
+{
+	// PSI is averaged over the window, so sampling much more often than this
+	// only sees noise
+	static const auto kInterval = time::toDuration(1.0);
+
+	auto now = time::now();
+	if (this->pressure_ == nullptr || now - this->adapted_ < kInterval) {
+		return;
+	}
+
+	// Only worth growing if the tests are using everything they've been
+	// given
+	auto busy = this->used_.cpus_ >= this->limit_ && this->tests_.size() > 0;
+
+	this->adapted_ = now;
+	this->limit_ = adaptJobs(this->limit_, this->opts_->jobs_min_.get(),
+							 (uint)this->jobs_.size(),
+							 this->pressure_->sample(), busy);
+}
+
 void Jobs::checkTimeouts()
 {
 	auto now = time::now();
 
 	for (auto &job : this->jobs_) {
-		if (job.checkTimeout(now)) {
-			this->runNextTest(&job);
-		}
+		job.checkTimeout(now);
+	}
+
+	// Killed cgroups are removed once they empty out, rather than holding
+	// everything up while they do
+	if (this->cgroups_ != nullptr) {
+		this->cgroups_->reap();
 	}
 }
 
@@ -317,22 +897,126 @@ void Jobs::flushPipes()
 Jobs::Jobs(sp<const Opts> opts,
 		   sp<Results> rslts,
 		   std::vector<sp<const Test>> tests)
-	: opts_(std::move(opts)), rslts_(std::move(rslts)), tests_(std::move(tests))
+	: opts_(std::move(opts)), rslts_(std::move(rslts))
 {
 	const auto jobs = this->opts_->jobs_.get();
 
 	uint i;
 
+	this->limit_ = jobs;
+	if (this->opts_->jobs_min_.get() > 0) {
+		this->pressure_ = Pressure::detect();
+		this->adapted_ = time::now();
+	}
+
 	if (_bin.size() == 0) {
 		_bin = this->opts_->bin_name_;
 	}
 
+	if (this->opts_->bench_.get()) {
+		_timer = mksp<time::BenchTimer>(this->opts_->bench_timer_.tsc());
+	}
+
+	if (this->opts_->record_impact_.get()) {
+		this->recorder_ = mksp<impact::Recorder>();
+	}
+
+	this->cov_ = Coverage::detect();
+
+	const auto &history = this->opts_->history_.get();
+	if (this->opts_->mem_budget_.get() > 0 && history.size() > 0
+		&& access(history.c_str(), F_OK) == 0) {
+		for (const auto &r : Results::load(history)) {
+			if (r.max_rss_ > 0) {
+				this->peaks_[r.test_name_] = r.max_rss_;
+			}
+		}
+	}
+
+	if (this->opts_->cgroup_.get()) {
+		Cgroup::Limits need;
+
+		for (const auto &test : tests) {
+			if (!test->enabled()) {
+				continue;
+			}
+
+			need.memory_max_ = std::max(need.memory_max_, test->memoryMax());
+			need.cpu_max_ = std::max(need.cpu_max_, test->cpuMax());
+			need.pids_max_ = std::max(need.pids_max_, test->pidsMax());
+		}
+
+		this->cgroups_ = Cgroups::create(need);
+	}
+
+	this->held_.resize(jobs);
+
+	for (const auto &test : tests) {
+		if (!test->enabled()) {
+			continue;
+		}
+
+		for (const auto &res : test->resources()) {
+			auto it = this->res_limits_.emplace(res.first, res.second).first;
+			it->second = std::min(it->second, res.second);
+		}
+	}
+
+	std::vector<cpu::Slot> slots;
+	if (this->opts_->pin_.get()) {
+		slots = cpu::slots(jobs);
+	}
+
 	this->jobs_.reserve(jobs);
 	for (i = 0; i < jobs; i++) {
 		this->jobs_.emplace_back(i, this->opts_, this->rslts_);
+
+		if (slots.size() > 0) {
+			this->jobs_.back().pinTo(std::move(slots[i]));
+		}
+
+		if (this->recorder_ != nullptr) {
+			this->jobs_.back().recordImpact(this->recorder_);
+		}
+
+		if (this->cov_ != nullptr) {
+			this->jobs_.back().collectCoverage(this->cov_);
+		}
+
+		if (this->cgroups_ != nullptr) {
+			this->jobs_.back().useCgroups(this->cgroups_);
+		}
+	}
+
+	// Tests that need the most CPUs start first, while there's room for them,
+	// and the rest fill in around them. Ties keep their shuffled order.
+	std::stable_sort(tests.begin(), tests.end(),
+					 [this](const sp<const Test> &a, const sp<const Test> &b) {
+						 return this->cost(*a).cpus_ > this->cost(*b).cpus_;
+					 });
+
+	failedFirst(*this->rslts_, &tests);
+	this->tests_.assign(tests.begin(), tests.end());
+
+	// Disabled tests only need reporting once
+	if (this->rslts_->repeat(1)) {
+		for (const auto &test : this->tests_) {
+			if (test->enabled()) {
+				this->round_.push_back(test);
+			}
+		}
 	}
 }
 
+void Jobs::failedFirst(const Results &rslts,
+					   std::vector<sp<const Test>> *tests)
+{
+	std::stable_partition(tests->begin(), tests->end(),
+						  [&](const sp<const Test> &t) {
+							  return rslts.failedLast(*t);
+						  });
+}
+
 void Jobs::terminate()
 {
 	for (auto &job : this->jobs_) {
@@ -342,9 +1026,7 @@ void Jobs::terminate()
 
 void Jobs::run()
 {
-	for (auto &job : this->jobs_) {
-		this->runNextTest(&job);
-	}
+	this->fill();
 
 	while (!this->rslts_->done()) {
 		sig::childWait();
@@ -353,23 +1035,39 @@ void Jobs::run()
 		while (!this->rslts_->done()) {
 			pid_t pid;
 			int status;
+			struct rusage ru;
 
-			pid = waitpid(-1, &status, WNOHANG);
-			OSErr(pid, {}, "waitpid() failed");
+			pid = wait4(-1, &status, WNOHANG, &ru);
+			OSErr(pid, {}, "wait4() failed");
 			if (pid == 0 || (!WIFEXITED(status) && !WIFSIGNALED(status))) {
 				break;
 			}
 
 			for (auto &job : this->jobs_) {
 				if (job.pid() == pid) {
-					job.cleanupStatus(status);
-					this->runNextTest(&job);
+					job.cleanupStatus(status, ru);
 					break;
 				}
 			}
+
+			this->fill();
 		}
 
 		this->checkTimeouts();
+		this->adapt();
+		this->fill();
+	}
+
+	if (this->cgroups_ != nullptr) {
+		this->cgroups_->drain();
+	}
+
+	if (this->recorder_ != nullptr) {
+		this->recorder_->save(this->opts_->impact_.get());
+	}
+
+	if (this->cov_ != nullptr) {
+		this->cov_->merge(this->opts_->jobs_.get());
 	}
 }
 }
@@ -408,6 +1106,18 @@ void pt_set_iter_name(const char *format, ...)
 	va_end(args);
 }
 
+void *pt_get_bench_state(void)
+{
+	auto job = pt::_jobs.top();
+	return job->bench_state_;
+}
+
+size_t pt_get_bench_wss(void)
+{
+	auto job = pt::_jobs.top();
+	return job->bench_wss_;
+}
+
 void _pt_fail(const char *format, ...)
 {
 	va_list args;
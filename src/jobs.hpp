@@ -8,11 +8,19 @@
  */
 
 #pragma once
+#include <list>
+#include <map>
 #include <setjmp.h>
+#include <sys/resource.h>
 #include <thread>
 #include <unistd.h>
 #include <vector>
+#include "cgroup.hpp"
+#include "cov.hpp"
+#include "cpu.hpp"
 #include "fork.hpp"
+#include "impact.hpp"
+#include "pressure.hpp"
 #include "results.hpp"
 #include "std.hpp"
 #include "test.hpp"
@@ -44,6 +52,16 @@ public:
 	 */
 	TestEnv *env_;
 
+	/**
+	 * State from the running benchmark's PTBENCHUP
+	 */
+	void *bench_state_ = nullptr;
+
+	/**
+	 * Working set size the running benchmark should use
+	 */
+	size_t bench_wss_ = 0;
+
 	SharedJob(sp<const Opts> opts) : opts_(std::move(opts))
 	{
 	}
@@ -66,9 +84,66 @@ class Job
 {
 	const uint id_;
 
+	/**
+	 * Only set while running a benchmark
+	 */
+	sp<Profiler> prof_;
+	sp<cpu::Evictor> evict_;
+
+	/**
+	 * Run a single, timed round of a benchmark
+	 */
+	time::duration benchRound(uint32_t n, size_t variant);
+
+	/**
+	 * Grow the number of iterations of a benchmark until a single round
+	 * takes at least `target`. Returns the number of iterations used in
+	 * the final round.
+	 */
+	uint32_t benchScale(time::duration target, size_t variant);
+
+	/**
+	 * Run single-iteration rounds, with cold caches, for `target`.
+	 */
+	uint32_t benchCold(time::duration target, size_t variant);
+
+	/**
+	 * Run the variants of a benchmark, alternating round-by-round.
+	 */
+	void benchCompare(time::duration max_dur);
+
+	/**
+	 * Run a benchmark at each working set size.
+	 */
+	void benchSweep(time::duration max_dur);
+
+	/**
+	 * Run a benchmark, however it needs to be run, in this process.
+	 */
+	void benchOnce(bool profile);
+
+	/**
+	 * Shift the stack and the heap by the given amounts, then run the
+	 * benchmark. Never returns.
+	 */
+	[[noreturn]] __attribute__((noinline)) void
+	benchLayout(size_t stack_pad, size_t heap_pad, bool profile);
+
+	/**
+	 * Run a benchmark in a new process for each of `layouts` randomized
+	 * memory layouts, aggregating the results across all of them.
+	 */
+	void benchLayouts(uint layouts);
+
 	void runBench();
 
 protected:
+	/**
+	 * Stop everything a benchmark that failed, and so never returned, left
+	 * running.
+	 */
+	void abandonBench();
+
 	sp<const Opts> opts_;
 	sp<Results> rslts_;
 	SharedJob *sj_;
@@ -193,6 +268,28 @@ class ForkingJob : public Job
 	 */
 	time::point timeout_after_;
 
+	/**
+	 * Only set when recording which functions tests call
+	 */
+	sp<impact::Recorder> recorder_;
+	sp<SharedMem<impact::Footprint>> footprint_;
+
+	/**
+	 * Only set when the binary writes LLVM profiles
+	 */
+	sp<Coverage> cov_;
+
+	/**
+	 * Only set when running tests in cgroups; cg_ only while a test runs
+	 */
+	sp<Cgroups> cgroups_;
+	sp<Cgroup> cg_;
+
+	/**
+	 * Only set with --pin
+	 */
+	sp<const cpu::Slot> slot_;
+
 	void flush(int fd, std::string *to);
 
 public:
@@ -210,6 +307,26 @@ public:
 		return -1;
 	}
 
+	/**
+	 * Record the footprint of every test run into the recorder
+	 */
+	void recordImpact(sp<impact::Recorder> recorder);
+
+	/**
+	 * Have every test write its profile into the coverage
+	 */
+	void collectCoverage(sp<Coverage> cov);
+
+	/**
+	 * Run every test in its own cgroup under the given subtree
+	 */
+	void useCgroups(sp<Cgroups> cgroups);
+
+	/**
+	 * Pin every test that fits in the slot to it
+	 */
+	void pinTo(cpu::Slot slot);
+
 	/**
 	 * Run this test.
 	 */
@@ -231,14 +348,19 @@ public:
 	void cleanup();
 
 	/**
-	 * The test finished with a status (from waitpid)
+	 * The test finished with a status and its usage (from wait4)
 	 */
-	void cleanupStatus(int status);
+	void cleanupStatus(int status, const struct rusage &ru);
 
 	/**
 	 * Terminate this test
 	 */
 	void terminate();
+
+	/**
+	 * Stop the running test, if any, recording it as not run
+	 */
+	void cancel();
 };
 
 /**
@@ -248,14 +370,94 @@ class Jobs
 {
 	sp<const Opts> opts_;
 	sp<Results> rslts_;
-	size_t testI_ = 0;
-	std::vector<sp<const Test>> tests_;
 	std::vector<ForkingJob> jobs_;
 
 	/**
-	 * Run the next test in the given job
+	 * Tests that haven't been started yet
+	 */
+	std::list<sp<const Test>> tests_;
+
+	/**
+	 * With --count or --until-fail, the tests that go into every round after
+	 * the first, and how many rounds have been queued
+	 */
+	std::vector<sp<const Test>> round_;
+	size_t rounds_ = 1;
+
+	/**
+	 * What a test needs while it runs: CPUs, out of --jobs, and the memory it's
+	 * expected to use, out of --mem-budget
+	 */
+	struct Cost {
+		uint cpus_ = 0;
+		uint64_t mem_ = 0;
+
+		/**
+		 * Resources from PTRES
+		 */
+		std::vector<std::string> res_;
+	};
+
+	/**
+	 * What each job's test holds, and the sum of it all
+	 */
+	std::vector<Cost> held_;
+	Cost used_;
+
+	/**
+	 * How many tests may hold each resource, and how many do
+	 */
+	std::map<std::string, uint> res_limits_;
+	std::map<std::string, uint> res_used_;
+
+	/**
+	 * How many CPUs tests may keep busy right now. Only moves when adapting
+	 * to pressure with --jobs-min.
+	 */
+	uint limit_;
+	sp<Pressure> pressure_;
+	time::point adapted_;
+
+	/**
+	 * Peak memory each test used in the --history run
+	 */
+	std::map<std::string, uint64_t> peaks_;
+	sp<impact::Recorder> recorder_;
+	sp<Coverage> cov_;
+	sp<Cgroups> cgroups_;
+
+	Cost cost(const Test &test) const;
+
+	/**
+	 * If a test with the given cost can start now
+	 */
+	bool fits(const Cost &c) const;
+
+	/**
+	 * If there are tests left to start, queueing another round of them when
+	 * one is due
+	 */
+	bool pending();
+
+	/**
+	 * Run the next test that fits in the given job
+	 */
+	void runNextTest(size_t j);
+
+	/**
+	 * Give a test to every idle job, as far as the budget allows
+	 */
+	void fill();
+
+	/**
+	 * Stop everything, running or not, once --fail-fast says so
 	 */
-	void runNextTest(Job *job);
+	void failFast();
+
+	/**
+	 * Every so often, grow or shrink the limit with system pressure
+	 */
+	void adapt();
 
 	/**
 	 * Kill any timed-out tests
@@ -275,6 +477,14 @@ public:
 		 sp<Results> rslts,
 		 std::vector<sp<const Test>> tests);
 
+	/**
+	 * Whatever failed last time is what's being worked on: move it to the
+	 * front, leaving everything else in order. Every run, forked or not,
+	 * orders its tests with this.
+	 */
+	static void failedFirst(const Results &rslts,
+							std::vector<sp<const Test>> *tests);
+
 	/**
 	 * Prematurely terminate all jobs. Only used from a signal handler to
 	 * clean up children before exiting.
@@ -7,6 +7,8 @@
  */
 
 #include <atomic>
+#include <fcntl.h>
+#include <sys/file.h>
 #include <iostream>
 #include <sys/wait.h>
 #include <thread>
@@ -162,6 +164,276 @@ TEST(jobsBenches)
 	pt_in("ns/op)", s);
 }
 
+TEST(jobsBenchesNoFork)
+{
+	std::stringstream out;
+
+	Main m({ MKTEST(_bench) });
+	m.run(out, { "paratec", "-b", "-d", ".05", "--nofork" });
+
+	auto s = out.str();
+	pt_in("Ran 1 benches.", s);
+	pt_in("BENCH : _bench", s);
+}
+
+static SharedMem<std::atomic_int> _benchUps;
+static SharedMem<std::atomic_int> _benchDowns;
+static int _benchStateVal;
+
+static void *_benchStateUp()
+{
+	_benchUps->fetch_add(1);
+	return &_benchStateVal;
+}
+
+static void _benchStateDown(void *state)
+{
+	pt_eq(state, (void *)&_benchStateVal);
+	_benchDowns->fetch_add(1);
+}
+
+TEST(_benchState,
+	 PTBENCH(),
+	 PTBENCHUP(_benchStateUp),
+	 PTBENCHDOWN(_benchStateDown))
+{
+	pt_eq(pt_get_bench_state(), (void *)&_benchStateVal);
+}
+
+TEST(jobsBenchState)
+{
+	std::stringstream out;
+
+	Main m({ MKTEST(_benchState) });
+	m.run(out, { "paratec", "-b", "-d", ".01" });
+
+	auto s = out.str();
+	pt_in("Ran 1 benches.", s);
+	pt_eq(_benchUps->load(), 1);
+	pt_eq(_benchDowns->load(), 1);
+}
+
+TEST(_benchCmp, PTCMP("slow, fast"))
+{
+	uint32_t i;
+	volatile uint32_t sum = 0;
+	uint32_t work = _i == 0 ? 64 : 1;
+
+	for (i = 0; i < _N * work; i++) {
+		sum += i;
+	}
+}
+
+TEST(jobsBenchCompare)
+{
+	std::stringstream out;
+
+	Main m({ MKTEST(_benchCmp) });
+	auto rslts = m.run(out, { "paratec", "-b", "-d", ".1" });
+
+	auto s = out.str();
+	pt_in("Ran 1 benches.", s);
+	pt_in("BENCH : _benchCmp", s);
+	pt_in("slow: ", s);
+	pt_in("(baseline)", s);
+	pt_in("vs slow", s);
+
+	auto r = rslts.get("_benchCmp");
+	pt_eq(r.bench_variants_.size(), (size_t)2);
+	pt_ge(r.bench_rounds_, (uint64_t)10);
+	pt_gt(r.bench_variants_[1].speedup_, 1.0);
+}
+
+TEST(_benchCold, PTBENCH())
+{
+	uint32_t i;
+
+	for (i = 0; i < _N; i++) {
+		pt_mark();
+	}
+}
+
+TEST(jobsBenchCold)
+{
+	std::stringstream out;
+
+	Main m({ MKTEST(_benchCold) });
+	auto rslts = m.run(out, { "paratec", "-b", "-d", ".01", "--bench-cold" });
+
+	pt_in("Ran 1 benches.", out.str());
+
+	// Cold benchmarks run 1 iteration per round, so iters is the number of
+	// rounds.
+	auto r = rslts.get("_benchCold");
+	pt_ge(r.bench_iters_, (uint64_t)10);
+}
+
+static SharedMem<std::atomic_int> _sweepUps;
+
+static void *_benchSweepUp()
+{
+	_sweepUps->fetch_add(1);
+	return calloc(1, pt_get_bench_wss());
+}
+
+static void _benchSweepDown(void *state)
+{
+	free(state);
+}
+
+TEST(_benchSweep,
+	 PTSWEEP(),
+	 PTBENCHUP(_benchSweepUp),
+	 PTBENCHDOWN(_benchSweepDown))
+{
+	uint32_t i;
+	size_t j;
+	auto wss = pt_get_bench_wss();
+	auto buff = (volatile char *)pt_get_bench_state();
+
+	pt_gt(wss, (size_t)0);
+
+	for (i = 0, j = 0; i < _N; i++, j = (j + 64) % wss) {
+		buff[j]++;
+	}
+}
+
+TEST(jobsBenchSweep)
+{
+	std::stringstream out;
+
+	Main m({ MKTEST(_benchSweep) });
+	auto rslts = m.run(out, { "paratec", "-b", "-d", ".01" });
+
+	auto s = out.str();
+	pt_in("Ran 1 benches.", s);
+	pt_in("L1   (", s);
+	pt_in("DRAM (", s);
+
+	auto r = rslts.get("_benchSweep");
+	pt_eq(r.bench_tiers_.size(), (size_t)_sweepUps->load());
+	pt_gt(r.bench_tiers_.back().wss_, r.bench_tiers_.front().wss_);
+}
+
+/**
+ * _benchSweep counts its setups across every test running at once
+ */
+TEST(_benchSweepMerged, PTSWEEP())
+{
+	uint32_t i;
+	volatile size_t sum = 0;
+
+	for (i = 0; i < _N; i++) {
+		sum += pt_get_bench_wss();
+	}
+}
+
+TEST(jobsBenchMerge)
+{
+	char path[] = "/tmp/paratec-bench-XXXXXX";
+	int fd = mkstemp(path);
+	pt_ne(fd, -1);
+	close(fd);
+
+	DTor d([&]() { unlink(path); });
+
+	std::stringstream out;
+	std::string oarg(std::string("--output=") + path);
+
+	Main m({ MKTEST(_benchCmp), MKTEST(_benchSweepMerged) });
+	m.run(out, { "paratec", "-b", "-d", ".01", oarg.c_str() });
+
+	// Everything about the benchmarks survives the trip through the file
+	std::stringstream merged;
+	std::string marg(std::string("--merge-results=") + path);
+
+	Main mm(std::vector<sp<const Test>>{});
+	auto rslts = mm.run(merged, { "paratec", "-b", marg.c_str() });
+
+	auto s = merged.str();
+	pt_in("interleaved rounds", s);
+	pt_in("vs slow", s);
+	pt_in("L1   (", s);
+	pt_in("DRAM (", s);
+
+	auto r = rslts.get("_benchCmp");
+	pt_eq(r.bench_variants_.size(), (size_t)2);
+	pt_gt(r.bench_variants_[1].speedup_, 1.0);
+	pt_gt(rslts.get("_benchSweepMerged").bench_tiers_.size(), (size_t)1);
+}
+
+TEST(_benchSweepCmp, PTSWEEP(), PTCMP("a, b"))
+{
+}
+
+TEST(jobsBenchSweepCmp)
+{
+	std::stringstream out;
+
+	Main m({ MKTEST(_benchSweepCmp) });
+	auto rslts = m.run(out, { "paratec", "-b", "-d", ".01" });
+
+	pt_in("PTSWEEP may not be combined with PTCMP", out.str());
+}
+
+TEST(jobsBenchTimerTSC)
+{
+	std::stringstream out;
+
+	Main m({ MKTEST(_benchCmp) });
+	auto rslts
+		= m.run(out, { "paratec", "-b", "-d", ".05", "--bench-timer=tsc" });
+
+	pt_in("Ran 1 benches.", out.str());
+
+	auto r = rslts.get("_benchCmp");
+	pt_gt(r.bench_variants_[1].speedup_, 1.0);
+}
+
+TEST(jobsBenchLayouts)
+{
+	std::stringstream out;
+
+	Main m({ MKTEST(_bench) });
+	auto rslts
+		= m.run(out, { "paratec", "-b", "-d", ".01", "--bench-layouts=3" });
+
+	auto s = out.str();
+	pt_in("Ran 1 benches.", s);
+	pt_in("3 layouts", s);
+
+	auto r = rslts.get("_bench");
+	pt_eq(r.bench_layouts_, (uint64_t)3);
+	pt_gt(r.bench_iters_, (uint64_t)0);
+}
+
+TEST(_benchLayoutsFail, PTBENCH())
+{
+	printf("layout output\n");
+	pt_fail("layout failure");
+}
+
+TEST(_benchLayoutsSig, PTBENCH())
+{
+	abort();
+}
+
+TEST(jobsBenchLayoutsFail)
+{
+	std::stringstream out;
+
+	Main m({ MKTEST(_benchLayoutsFail), MKTEST(_benchLayoutsSig) });
+	auto rslts = m.run(out, { "paratec", "-b", "-d", ".01",
+							  "--bench-layouts=3" });
+
+	auto s = out.str();
+	pt_in("layout failure", s);
+	pt_in("layout output", s);
+
+	pt(rslts.get("_benchLayoutsFail").failed_);
+	pt_eq(rslts.get("_benchLayoutsSig").signal_num_, SIGABRT);
+}
+
 TEST(jobsAbortSignal, PTSIG(SIGABRT))
 {
 	abort();
@@ -553,4 +825,426 @@ TEST(jobsAssertionLines)
 	res = rslts.get("_assertMarkBeforeOut");
 	pt_in("last test assert: " __FILE__, res.last_line_);
 }
+
+static std::string _lockPath(pid_t pid)
+{
+	return "/tmp/paratec-jobs-lock-" + std::to_string(pid);
+}
+
+/**
+ * Fails if a test holding the lock in a conflicting way (see flock()) is
+ * running at the same time
+ */
+static void _hold(int op)
+{
+	int fd = open(_lockPath(getppid()).c_str(), O_CREAT | O_RDONLY, 0600);
+	pt_ne(fd, -1);
+
+	pt_eq(flock(fd, op | LOCK_NB), 0, "another test is running at the same time");
+	usleep(20000);
+	close(fd);
+}
+
+static void _exclusive()
+{
+	_hold(LOCK_EX);
+}
+
+TEST(_jobsMem0, PTMEM(2))
+{
+	_exclusive();
+}
+
+TEST(_jobsMem1, PTMEM(2))
+{
+	_exclusive();
+}
+
+TEST(_jobsMem2, PTMEM(2))
+{
+	_exclusive();
+}
+
+TEST(_jobsHog)
+{
+	size_t i;
+	const size_t size = 64 * 1024 * 1024;
+	auto volatile p = (char *)malloc(size);
+
+	for (i = 0; i < size; i += 4096) {
+		p[i] = 1;
+	}
+
+	free(p);
+}
+
+TEST(jobsMaxRSS)
+{
+	std::stringstream out;
+
+	Main m({ MKTEST(_jobsHog) });
+	auto rslts = m.run(out, { "paratec" });
+
+	pt_eq(rslts.exitCode(), 0);
+	pt_ge(rslts.get("_jobsHog").max_rss_, (uint64_t)64 * 1024 * 1024);
+}
+
+TEST(jobsMemBudget)
+{
+	std::stringstream out;
+
+	Main m({ MKTEST(_jobsMem0), MKTEST(_jobsMem1), MKTEST(_jobsMem2) });
+	auto rslts = m.run(out, { "paratec", "-j", "3", "--mem-budget", "3" });
+	unlink(_lockPath(getpid()).c_str());
+
+	pt_eq(rslts.exitCode(), 0);
+}
+
+TEST(jobsMemBudgetHistory)
+{
+	std::stringstream out;
+	char hist[] = "/tmp/paratec-jobs-hist-XXXXXX";
+
+	int fd = mkstemp(hist);
+	pt_ne(fd, -1);
+	close(fd);
+
+	{
+		Main m({ MKTEST(_jobsMem0), MKTEST(_jobsMem1) });
+		auto rslts = m.run(out, { "paratec", "-j", "1", "-o", hist });
+		pt_eq(rslts.exitCode(), 0);
+	}
+
+	// Every test used more than a byte last time, so they have to go one at
+	// a time, no matter what PTMEM says
+	Main m({ MKTEST(_jobsMem0), MKTEST(_jobsMem1) });
+	auto rslts = m.run(out, { "paratec", "-j", "2", "--mem-budget", "1",
+							  "--history", hist });
+	unlink(hist);
+	unlink(_lockPath(getpid()).c_str());
+
+	pt_eq(rslts.exitCode(), 0);
+}
+
+TEST(_jobsCpus0, PTCPUS(3))
+{
+	_exclusive();
+}
+
+TEST(_jobsCpus1, PTCPUS(3))
+{
+	_exclusive();
+}
+
+TEST(_jobsSerial, PTSERIAL())
+{
+	_exclusive();
+}
+
+TEST(_jobsShared0)
+{
+	_hold(LOCK_SH);
+}
+
+TEST(_jobsShared1)
+{
+	_hold(LOCK_SH);
+}
+
+TEST(_jobsShared2)
+{
+	_hold(LOCK_SH);
+}
+
+TEST(jobsCpus)
+{
+	std::stringstream out;
+
+	Main m({ MKTEST(_jobsCpus0), MKTEST(_jobsCpus1) });
+	auto rslts = m.run(out, { "paratec", "-j", "4" });
+	unlink(_lockPath(getpid()).c_str());
+
+	pt_eq(rslts.exitCode(), 0);
+}
+
+TEST(jobsCpusMoreThanJobs)
+{
+	std::stringstream out;
+
+	Main m({ MKTEST(_jobsCpus0), MKTEST(_0) });
+	auto rslts = m.run(out, { "paratec", "-j", "2" });
+	unlink(_lockPath(getpid()).c_str());
+
+	pt_eq(rslts.exitCode(), 0);
+}
+
+TEST(jobsSerial)
+{
+	std::stringstream out;
+
+	Main m({ MKTEST(_jobsSerial), MKTEST(_jobsShared0), MKTEST(_jobsShared1),
+			 MKTEST(_jobsShared2) });
+	auto rslts = m.run(out, { "paratec", "-j", "4" });
+	unlink(_lockPath(getpid()).c_str());
+
+	pt_eq(rslts.exitCode(), 0);
+}
+
+TEST(_jobsRes0, PTRES("jobsRes", 1))
+{
+	_exclusive();
+}
+
+TEST(_jobsRes1, PTRES("jobsRes", 1))
+{
+	_exclusive();
+}
+
+TEST(_jobsRes2, PTRES("jobsRes", 3))
+{
+	_exclusive();
+}
+
+TEST(jobsRes)
+{
+	std::stringstream out;
+
+	Main m({ MKTEST(_jobsRes0), MKTEST(_jobsRes1), MKTEST(_jobsRes2),
+			 MKTEST(_0), MKTEST(_1) });
+	auto rslts = m.run(out, { "paratec", "-j", "4" });
+	unlink(_lockPath(getpid()).c_str());
+
+	pt_eq(rslts.exitCode(), 0);
+}
+
+/**
+ * Like _exclusive(), but only against tests using the same resource
+ */
+static void _exclusiveRes(const char *res)
+{
+	auto path = _lockPath(getppid()) + "-" + res;
+	int fd = open(path.c_str(), O_CREAT | O_RDONLY, 0600);
+	pt_ne(fd, -1);
+
+	pt_eq(flock(fd, LOCK_EX | LOCK_NB), 0, "another %s test is running", res);
+	usleep(20000);
+	close(fd);
+}
+
+TEST(_jobsResA, PTRES("jobsResA", 1))
+{
+	_exclusiveRes("a");
+}
+
+TEST(_jobsResB, PTRES("jobsResB", 1))
+{
+	_exclusiveRes("b");
+}
+
+TEST(_jobsResAB, PTRES("jobsResA", 1), PTRES("jobsResB", 1))
+{
+	_exclusiveRes("a");
+	_exclusiveRes("b");
+}
+
+TEST(jobsResMany)
+{
+	std::stringstream out;
+
+	Main m({ MKTEST(_jobsResA), MKTEST(_jobsResB), MKTEST(_jobsResAB),
+			 MKTEST(_jobsResA), MKTEST(_jobsResB), MKTEST(_jobsResAB) });
+	auto rslts = m.run(out, { "paratec", "-j", "4" });
+	unlink((_lockPath(getpid()) + "-a").c_str());
+	unlink((_lockPath(getpid()) + "-b").c_str());
+
+	pt_eq(rslts.exitCode(), 0);
+}
+
+TEST(_jobsFail0)
+{
+	pt_fail("fail");
+}
+
+TEST(_jobsFail1)
+{
+	pt_fail("fail");
+}
+
+TEST(_jobsFail2)
+{
+	pt_fail("fail");
+}
+
+TEST(_jobsFail3)
+{
+	pt_fail("fail");
+}
+
+TEST(_jobsSlow)
+{
+	sleep(10);
+}
+
+TEST(_jobsFailRange, PTI(0, 10), PTFAILFAST())
+{
+	pt_fail("fail");
+}
+
+TEST(jobsFailFast)
+{
+	std::stringstream out;
+
+	Main m({ MKTEST(_jobsFail0), MKTEST(_jobsFail1), MKTEST(_jobsFail2),
+			 MKTEST(_jobsFail3) });
+	auto rslts = m.run(out, { "paratec", "-j", "1", "--fail-fast" });
+
+	pt_eq(rslts.exitCode(), 1);
+	pt_in("1 failures, 0 skipped, 3 not run.", out.str());
+}
+
+TEST(jobsFailFastN)
+{
+	std::stringstream out;
+
+	Main m({ MKTEST(_jobsFail0), MKTEST(_jobsFail1), MKTEST(_jobsFail2),
+			 MKTEST(_jobsFail3) });
+	auto rslts = m.run(out, { "paratec", "-j", "1", "--fail-fast=2" });
+
+	pt_eq(rslts.exitCode(), 1);
+	pt_in("2 failures, 0 skipped, 2 not run.", out.str());
+}
+
+TEST(jobsFailFastRunning)
+{
+	std::stringstream out;
+
+	Main m({ MKTEST(_jobsSlow), MKTEST(_jobsFail0) });
+	auto rslts = m.run(out, { "paratec", "-j", "2", "--fail-fast", "-vvv" });
+
+	pt_eq(rslts.exitCode(), 1);
+	pt(rslts.get("_jobsSlow").notrun_);
+	pt_in("NOT RUN : _jobsSlow", out.str());
+}
+
+TEST(jobsFailFastNoFork)
+{
+	auto e = Fork().run([]() {
+		Main m({ MKTEST(_jobsFail0), MKTEST(_jobsFail1), MKTEST(_jobsFail2),
+				 MKTEST(_jobsFail3) });
+		m.run(std::cout, { "paratec", "--nofork", "--fail-fast" });
+	});
+
+	pt_in("1 failures, 0 skipped, 3 not run.", e.stdout_);
+}
+
+TEST(jobsFailFastRange)
+{
+	std::stringstream out;
+
+	Main m({ MKTEST(_jobsFailRange), MKTEST(_0) });
+	auto rslts = m.run(out, { "paratec", "-j", "1" });
+
+	pt_eq(rslts.exitCode(), 1);
+	pt_in("1 OK, 0 errors, 1 failures, 0 skipped, 9 not run.", out.str());
+}
+
+TEST(_jobsFlaky)
+{
+	int n = 0;
+	int fd = open(getenv("PT_JOBS_FLAKY"), O_RDWR);
+	pt_ne(fd, -1);
+	pt_eq(flock(fd, LOCK_EX), 0);
+
+	FILE *f = fdopen(fd, "r+");
+	pt_ne(f, nullptr);
+	if (fscanf(f, "%d", &n) != 1) {
+		n = 0;
+	}
+
+	rewind(f);
+	fprintf(f, "%d\n", ++n);
+	fclose(f);
+
+	pt_ne(n, 5, "flaked");
+}
+
+TEST(jobsCount)
+{
+	std::stringstream out;
+
+	Main m({ MKTEST(_0), MKTEST(_1) });
+	auto rslts = m.run(out, { "paratec", "-j", "4", "--count=5", "-v" });
+
+	pt_eq(rslts.exitCode(), 0);
+	pt_in("of 10 tests run, 10 OK", out.str());
+	pt_in("REPEAT : _0 : 0 of 5 failed", out.str());
+}
+
+TEST(jobsCountFailures)
+{
+	std::stringstream out;
+
+	Main m({ MKTEST(_jobsFail0), MKTEST(_0) });
+	auto rslts = m.run(out, { "paratec", "-j", "2", "--count=3" });
+
+	pt_eq(rslts.exitCode(), 1);
+	pt_in("of 6 tests run, 3 OK, 0 errors, 3 failures", out.str());
+	pt_in("REPEAT : _jobsFail0 : 3 of 3 failed", out.str());
+	pt_ni("REPEAT : _0", out.str());
+}
+
+TEST(jobsCountNoFork)
+{
+	auto e = Fork().run([]() {
+		Main m({ MKTEST(_0), MKTEST(_1) });
+		m.run(std::cout, { "paratec", "--nofork", "--count=3" });
+	});
+
+	pt_in("of 6 tests run, 6 OK", e.stdout_);
+}
+
+TEST(jobsCountCache, PTEXIT(1))
+{
+	std::stringstream out;
+
+	Main m(std::vector<sp<const Test>>{});
+	m.run(out, { "paratec", "--count=2", "--cache=/tmp" });
+}
+
+TEST(jobsUntilFail)
+{
+	std::stringstream out;
+	char path[] = "/tmp/paratec-flaky-XXXXXX";
+
+	int fd = mkstemp(path);
+	pt_ne(fd, -1);
+	close(fd);
+	setenv("PT_JOBS_FLAKY", path, 1);
+
+	Main m({ MKTEST(_jobsFlaky) });
+	auto rslts = m.run(out, { "paratec", "-j", "2", "--until-fail" });
+
+	int n = 0;
+	FILE *f = fopen(path, "r");
+	pt_ne(f, nullptr);
+	pt_eq(fscanf(f, "%d", &n), 1);
+	fclose(f);
+	unlink(path);
+
+	pt_eq(rslts.exitCode(), 1);
+	pt_in("1 failures", out.str());
+	pt_in("REPEAT : _jobsFlaky : 1 of", out.str());
+	pt_ge(n, 5);
+}
+
+TEST(jobsUntilFailCount)
+{
+	std::stringstream out;
+
+	Main m({ MKTEST(_0) });
+	auto rslts = m.run(out, { "paratec", "-j", "2", "--until-fail", "--count=3" });
+
+	pt_eq(rslts.exitCode(), 0);
+	pt_in("of 3 tests run, 3 OK", out.str());
+}
 }
@@ -0,0 +1,123 @@
+/**
+ * @author Andrew Stone <a@stoney.io>
+ * @copyright 2016 Andrew Stone
+ *
+ * This file is part of paratec and is released under the MIT License:
+ * http://opensource.org/licenses/MIT
+ */
+
+#include <dlfcn.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "err.hpp"
+#include "leaks.hpp"
+
+namespace pt
+{
+namespace leaks
+{
+
+/**
+ * Set in everything the helper is preloaded into, to tell a helper that
+ * failed to load apart from one that was never asked for
+ */
+static const char *kInjected = "PT_LEAKS_INJECTED";
+
+/**
+ * What the helper exports: see preload/leaks.cpp
+ */
+typedef int (*_StartFn)(void);
+typedef char *(*_CheckFn)(void);
+
+template <typename T> static T _sym(const char *name)
+{
+	return (T)dlsym(RTLD_DEFAULT, name);
+}
+
+/**
+ * The helper is installed next to libparatec; failing that, it's left to the
+ * loader to find.
+ */
+static std::string _helper()
+{
+	Dl_info info;
+	char path[PATH_MAX];
+
+	if (dladdr((void *)_helper, &info) != 0 && info.dli_fname != nullptr
+		&& realpath(info.dli_fname, path) != nullptr) {
+		std::string dir(path);
+		auto helper = dir.substr(0, dir.rfind('/') + 1) + kHelper;
+
+		if (access(helper.c_str(), R_OK) == 0) {
+			return helper;
+		}
+	}
+
+	return kHelper;
+}
+
+bool loaded()
+{
+	if (_sym<_StartFn>("pt_leaks_start") != nullptr) {
+		return true;
+	}
+
+	if (getenv(kInjected) != nullptr) {
+		Err(-1, "failed to preload %s for leak checking", kHelper);
+	}
+
+	return false;
+}
+
+void inject()
+{
+	int err;
+	auto preload = _helper();
+
+	auto existing = getenv("LD_PRELOAD");
+	if (existing != nullptr && existing[0] != '\0') {
+		preload += ':';
+		preload += existing;
+	}
+
+	err = setenv("LD_PRELOAD", preload.c_str(), 1);
+	OSErr(err, {}, "failed to set LD_PRELOAD");
+
+	err = setenv(kInjected, "1", 1);
+	OSErr(err, {}, "failed to set %s", kInjected);
+}
+
+void start()
+{
+	auto fn = _sym<_StartFn>("pt_leaks_start");
+
+	if (fn == nullptr) {
+		Err(-1, "%s isn't loaded", kHelper);
+	}
+
+	if (fn() != 0) {
+		OSErr(-1, {}, "failed to map memory for leak tracking");
+	}
+}
+
+bool check(std::string *msg)
+{
+	auto fn = _sym<_CheckFn>("pt_leaks_check");
+
+	if (fn == nullptr) {
+		return false;
+	}
+
+	auto leaked = fn();
+	if (leaked == nullptr) {
+		return false;
+	}
+
+	*msg = leaked;
+	free(leaked);
+
+	return true;
+}
+}
+}
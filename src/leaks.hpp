@@ -0,0 +1,59 @@
+/**
+ * @file
+ * @author Andrew Stone <a@stoney.io>
+ * @copyright 2016 Andrew Stone
+ *
+ * This file is part of paratec and is released under the MIT License:
+ * http://opensource.org/licenses/MIT
+ */
+
+#pragma once
+#include <stddef.h>
+#include <string>
+#include "paratec.h"
+
+namespace pt
+{
+namespace leaks
+{
+
+/**
+ * Allocations can only be tracked where there's a libc allocator to wrap
+ */
+#if defined(PT_LINUX) && defined(__GLIBC__)
+static constexpr bool kSupported = true;
+#else
+static constexpr bool kSupported = false;
+#endif
+
+/**
+ * Tracking allocations means replacing the allocator, which libparatec never
+ * does itself: that's left to this helper, preloaded only into the binaries
+ * that run tests with --leaks.
+ */
+static constexpr const char *kHelper = "libparatec-leaks.so";
+
+/**
+ * If the helper is loaded into this process. Throws if it was meant to be but
+ * couldn't be.
+ */
+bool loaded();
+
+/**
+ * Preload the helper into whatever this process execs next
+ */
+void inject();
+
+/**
+ * Start tracking every allocation made in this process. Only ever called from
+ * a forked test with the helper loaded: the tracking is never torn down.
+ */
+void start();
+
+/**
+ * Stop tracking. If anything allocated since start() is still around, returns
+ * true with a description of what leaked and where it was allocated from.
+ */
+bool check(std::string *msg);
+}
+}
@@ -0,0 +1,95 @@
+/**
+ * @author Andrew Stone <a@stoney.io>
+ * @copyright 2016 Andrew Stone
+ *
+ * This file is part of paratec and is released under the MIT License:
+ * http://opensource.org/licenses/MIT
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "main.hpp"
+#include "util_test.hpp"
+
+namespace pt
+{
+
+TEST(_leaksLeak)
+{
+	auto volatile p = malloc(100);
+	(void)p;
+}
+
+TEST(_leaksEvery)
+{
+	auto volatile v = valloc(100);
+	auto volatile r = reallocarray(nullptr, 10, 20);
+	(void)v;
+	(void)r;
+}
+
+TEST(_leaksClean)
+{
+	auto p = malloc(100);
+	p = realloc(p, 1000);
+	p = reallocarray(p, 10, 200);
+	free(p);
+
+	free(valloc(100));
+
+	void *aligned;
+	pt_eq(posix_memalign(&aligned, 64, 128), 0);
+	free(aligned);
+
+	free(strdup("not a leak"));
+	delete new std::string(100, 'a');
+
+	printf("printing isn't a leak either\n");
+}
+
+TEST(leaksReport)
+{
+	std::stringstream out;
+
+	Main m({ MKTEST(_leaksLeak), MKTEST(_leaksClean) });
+	auto rslts = m.run(out, { "paratec", "--leaks", "-v" });
+
+	pt_eq(rslts.exitCode(), 1);
+	pt_in("PASS : _leaksClean", out.str());
+	pt_in("FAIL : _leaksLeak", out.str());
+	pt_in("leaked 100 bytes in 1 allocations", out.str());
+	pt_in("100 bytes in 1 allocations from:\n",
+		  rslts.get("_leaksLeak").fail_msg_);
+	pt_in("pt::Test::run", rslts.get("_leaksLeak").fail_msg_);
+}
+
+TEST(leaksEvery)
+{
+	std::stringstream out;
+
+	Main m({ MKTEST(_leaksEvery) });
+	auto rslts = m.run(out, { "paratec", "--leaks" });
+
+	pt_eq(rslts.exitCode(), 1);
+	pt_in("leaked 300 bytes in 2 allocations",
+		  rslts.get("_leaksEvery").fail_msg_);
+}
+
+TEST(leaksOff)
+{
+	std::stringstream out;
+
+	Main m({ MKTEST(_leaksLeak) });
+	auto rslts = m.run(out, { "paratec" });
+
+	pt_eq(rslts.exitCode(), 0);
+}
+
+TEST(leaksNoFork, PTEXIT(1))
+{
+	std::stringstream out;
+
+	Main m(std::vector<sp<const Test>>{});
+	m.run(out, { "paratec", "--leaks", "--nofork" });
+}
+}
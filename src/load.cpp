@@ -0,0 +1,149 @@
+/**
+ * @author Andrew Stone <a@stoney.io>
+ * @copyright 2016 Andrew Stone
+ *
+ * This file is part of paratec and is released under the MIT License:
+ * http://opensource.org/licenses/MIT
+ */
+
+#include <dlfcn.h>
+#include <fstream>
+#include <string.h>
+#include "err.hpp"
+#include "load.hpp"
+
+#ifdef PT_LINUX
+#include <elf.h>
+#include <link.h>
+#elif defined(PT_DARWIN)
+#include <limits.h>
+#include <mach-o/dyld.h>
+#include <mach-o/getsect.h>
+#include <stdlib.h>
+#endif
+
+namespace pt
+{
+
+#ifdef PT_LINUX
+
+/**
+ * The linker's __start_/__stop_ symbols for the section are local to the
+ * shared object, so the section has to be found the hard way: by reading the
+ * object's section headers.
+ */
+static bool _findSection(const char *path, ElfW(Addr) *addr, size_t *size)
+{
+	ElfW(Ehdr) eh;
+	std::ifstream f(path, std::ios::binary);
+
+	if (!f.read((char *)&eh, sizeof(eh))
+		|| memcmp(eh.e_ident, ELFMAG, SELFMAG) != 0
+		|| eh.e_shentsize != sizeof(ElfW(Shdr))) {
+		Err(-1, "%s is not a shared object", path);
+	}
+
+	std::vector<ElfW(Shdr)> shdrs(eh.e_shnum);
+	f.seekg((std::streamoff)eh.e_shoff);
+	f.read((char *)shdrs.data(),
+		   (std::streamsize)(shdrs.size() * sizeof(ElfW(Shdr))));
+
+	if (!f || eh.e_shstrndx >= shdrs.size()) {
+		Err(-1, "%s has invalid section headers", path);
+	}
+
+	const auto &strs = shdrs[eh.e_shstrndx];
+	std::vector<char> names(strs.sh_size + 1, '\0');
+	f.seekg((std::streamoff)strs.sh_offset);
+	f.read(names.data(), (std::streamsize)strs.sh_size);
+
+	if (!f) {
+		Err(-1, "%s has invalid section names", path);
+	}
+
+	for (const auto &sh : shdrs) {
+		if (sh.sh_name < strs.sh_size
+			&& strcmp(names.data() + sh.sh_name, PT_SECTION_NAME) == 0) {
+			*addr = sh.sh_addr;
+			*size = sh.sh_size;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static std::pair<const _paratec_desc **, size_t>
+_getSection(void *handle, const std::string &path)
+{
+	int err;
+	ElfW(Addr) addr;
+	size_t size;
+	struct link_map *lm;
+
+	err = dlinfo(handle, RTLD_DI_LINKMAP, &lm);
+	if (err != 0) {
+		Err(-1, "failed to inspect %s: %s", path.c_str(), dlerror());
+	}
+
+	// l_name is where the object was actually found, after searching
+	if (!_findSection(lm->l_name, &addr, &size)) {
+		return { nullptr, 0 };
+	}
+
+	return {
+		(const _paratec_desc **)(lm->l_addr + addr),
+		size / sizeof(const _paratec_desc *),
+	};
+}
+
+#elif defined(PT_DARWIN)
+
+static std::pair<const _paratec_desc **, size_t>
+_getSection(void *, const std::string &path)
+{
+	uint32_t i;
+	char want[PATH_MAX];
+	char have[PATH_MAX];
+
+	if (realpath(path.c_str(), want) == nullptr) {
+		return { nullptr, 0 };
+	}
+
+	for (i = 0; i < _dyld_image_count(); i++) {
+		unsigned long size;
+
+		if (realpath(_dyld_get_image_name(i), have) == nullptr
+			|| strcmp(want, have) != 0) {
+			continue;
+		}
+
+		auto mh = (const struct mach_header_64 *)_dyld_get_image_header(i);
+		auto data = getsectiondata(mh, "__DATA", PT_SECTION_NAME, &size);
+
+		return {
+			(const _paratec_desc **)data, size / sizeof(const _paratec_desc *),
+		};
+	}
+
+	return { nullptr, 0 };
+}
+
+#endif
+
+std::vector<const _paratec_desc *> loadSuite(const std::string &path)
+{
+	// Never closed: see loadSuite()'s docs
+	void *handle = dlopen(path.c_str(), RTLD_NOW | RTLD_GLOBAL);
+	if (handle == nullptr) {
+		Err(-1, "failed to load %s: %s", path.c_str(), dlerror());
+	}
+
+	auto sect = _getSection(handle, path);
+	if (sect.first == nullptr) {
+		Err(-1, "%s doesn't contain any tests", path.c_str());
+	}
+
+	return { sect.first, sect.first + sect.second };
+}
+}
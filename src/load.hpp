@@ -0,0 +1,28 @@
+/**
+ * @file
+ * @author Andrew Stone <a@stoney.io>
+ * @copyright 2016 Andrew Stone
+ *
+ * This file is part of paratec and is released under the MIT License:
+ * http://opensource.org/licenses/MIT
+ */
+
+#pragma once
+#include <string>
+#include <vector>
+#include "paratec.h"
+
+namespace pt
+{
+
+/**
+ * Load a shared object full of tests and get their descriptors. The shared
+ * object stays loaded for the life of the process: its tests are run from
+ * forked children, and descriptors point into it.
+ *
+ * The shared object's tests call into paratec, so it shouldn't carry its own
+ * copy: it should leave paratec's symbols to be resolved against the binary
+ * loading it.
+ */
+std::vector<const _paratec_desc *> loadSuite(const std::string &path);
+}
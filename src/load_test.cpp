@@ -0,0 +1,64 @@
+/**
+ * @author Andrew Stone <a@stoney.io>
+ * @copyright 2016 Andrew Stone
+ *
+ * This file is part of paratec and is released under the MIT License:
+ * http://opensource.org/licenses/MIT
+ */
+
+#include "load.hpp"
+#include "main.hpp"
+#include "util_test.hpp"
+
+namespace pt
+{
+
+/**
+ * Built from test/load_suite.c by the Makefile
+ */
+static const char *kSuite = "./libparatec_load.test.so";
+
+TEST(loadSuite)
+{
+	std::stringstream out;
+	std::string larg(std::string("--load=") + kSuite);
+
+	Main m(std::vector<sp<const Test>>{});
+	auto rslts = m.run(out, { "paratec", larg.c_str(), "-f", "_load" });
+
+	pt_in("of 6 tests run, 5 OK, 0 errors, 1 failures", out.str());
+
+	auto r = rslts.get("_loadFail");
+	pt(r.failed_);
+	pt_in("failed in a loaded suite", r.fail_msg_);
+}
+
+TEST(loadSuiteModifiers)
+{
+	std::stringstream out;
+	std::string larg(std::string("--load=") + kSuite);
+
+	Main m(std::vector<sp<const Test>>{});
+	m.run(out, { "paratec", larg.c_str(), "--list", "-f", "_loadTimeout" });
+
+	pt_eq(out.str(), "_loadTimeout\t3.000000\n");
+}
+
+TEST(loadSuiteErrors)
+{
+	try {
+		loadSuite("./does-not-exist.so");
+		pt_fail("loaded a missing suite");
+	} catch (const Err &e) {
+		pt_in("failed to load", e.what());
+	}
+
+	// The C library has no tests
+	try {
+		loadSuite("libc.so.6");
+		pt_fail("found tests in libc");
+	} catch (const Err &e) {
+		pt_in("doesn't contain any tests", e.what());
+	}
+}
+}
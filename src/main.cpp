@@ -8,11 +8,20 @@
 
 #include <algorithm>
 #include <iostream>
+#include <limits.h>
+#include <map>
 #include <random>
+#include <string.h>
+#include <unistd.h>
+#include "impact.hpp"
 #include "jobs.hpp"
+#include "leaks.hpp"
+#include "load.hpp"
 #include "main.hpp"
 #include "paratec.h"
+#include "remote.hpp"
 #include "signal.hpp"
+#include "util.hpp"
 
 extern "C" {
 #ifdef PT_LINUX
@@ -22,14 +31,14 @@ extern "C" {
  * pointer, anything larger than a few words causes the section to be
  * misaligned, and you can't access anything.
  */
-extern struct _paratec *__start_paratec;
-extern struct _paratec *__stop_paratec;
+extern const struct _paratec_desc *__start_paratec;
+extern const struct _paratec_desc *__stop_paratec;
 
 #elif defined(PT_DARWIN)
 
-extern struct _paratec *
+extern const struct _paratec_desc *
 	__start_paratec __asm("section$start$__DATA$" PT_SECTION_NAME);
-extern struct _paratec *
+extern const struct _paratec_desc *
 	__stop_paratec __asm("section$end$__DATA$" PT_SECTION_NAME);
 
 #endif
@@ -38,15 +47,8 @@ extern struct _paratec *
 namespace pt
 {
 
-Main::Main()
+Main::Main() : descs_(&__start_paratec, &__stop_paratec)
 {
-	_paratec **sp;
-
-	sp = &__start_paratec;
-	while (sp < &__stop_paratec) {
-		this->tests_.emplace_back(mksp<Test>(**sp));
-		sp++;
-	}
 }
 
 Results Main::main(std::ostream &os, int argc, char **argv)
@@ -74,10 +76,50 @@ Results Main::run(std::ostream &os, const std::vector<const char *> &args)
 	this->opts_->parse(std::move(args));
 	auto rslts = mksp<Results>(this->opts_, os);
 
-	auto addTest = [&](sp<const Test> t) {
-		rslts->inc(t->enabled());
-		tests.push_back(std::move(t));
-	};
+	const auto &merges = this->opts_->merge_results_.get();
+	if (merges.size() > 0) {
+		for (const auto &path : merges) {
+			rslts->merge(path);
+		}
+
+		rslts->dump();
+		this->writeResults(*rslts);
+
+		return *rslts;
+	}
+
+	for (const auto &so : this->opts_->load_.get()) {
+		auto descs = loadSuite(so);
+		this->descs_.insert(this->descs_.end(), descs.begin(), descs.end());
+	}
+
+	// Tests from other binaries run instead of this binary's. Their results
+	// files live as long as this does.
+	sp<Remotes> remotes;
+	const auto &bins = this->opts_->binaries_.get();
+	if (bins.size() > 0) {
+		remotes = mksp<Remotes>();
+		this->descs_.clear();
+		this->tests_.clear();
+
+		for (const auto &bin : bins) {
+			auto ts = remotes->list(bin, *this->opts_);
+			this->tests_.insert(this->tests_.end(), ts.begin(), ts.end());
+		}
+	}
+
+	auto addTest = [&](sp<const Test> t) { tests.push_back(std::move(t)); };
+
+	// Disabled tests are only reported when showing all statuses; otherwise,
+	// tests that can't be selected don't even need to be looked at.
+	const bool all = this->opts_->verbose_.allStatuses();
+	for (auto desc : this->descs_) {
+		if (all || this->opts_->filter_.get().mayMatch(desc->name_)) {
+			this->tests_.emplace_back(mksp<Test>(*desc));
+		}
+	}
+
+	this->descs_.clear();
 
 	for (auto &test : this->tests_) {
 		bool ranged;
@@ -95,6 +137,27 @@ Results Main::run(std::ostream &os, const std::vector<const char *> &args)
 		}
 	}
 
+	if (this->opts_->changed_files_.get().size() > 0) {
+		tests = this->impacted(std::move(tests));
+	}
+
+	if (this->opts_->shard_.count() > 1) {
+		tests = this->shard(std::move(tests));
+	}
+
+	if (this->opts_->list_.get()) {
+		this->list(os, std::move(tests));
+		return *rslts;
+	}
+
+	if (this->opts_->leaks_.get() && !leaks::loaded()) {
+		tests = this->leakChecked(std::move(tests), &remotes);
+	}
+
+	for (const auto &t : tests) {
+		rslts->inc(t->enabled());
+	}
+
 	// Shuffle tests on each run to ensure that tests don't accidentally rely
 	// on implied ordering.
 	std::shuffle(tests.begin(), tests.end(), std::random_device());
@@ -110,16 +173,177 @@ Results Main::run(std::ostream &os, const std::vector<const char *> &args)
 		rslts->startTimer();
 		jobs->run();
 	} else {
+		Jobs::failedFirst(*rslts, &tests);
 		rslts->startTimer();
-		for (auto &test : tests) {
-			BasicJob(0, this->opts_, rslts).run(test);
+		size_t rounds = 0;
+		auto round = tests;
+
+		while (round.size() > 0) {
+			for (const auto &test : round) {
+				if (rslts->failingFast() || rslts->abandoned(*test)) {
+					rslts->cancel(test);
+				} else {
+					BasicJob(0, this->opts_, rslts).run(test);
+				}
+			}
+
+			round.clear();
+			if (rslts->repeat(++rounds)) {
+				for (const auto &test : tests) {
+					if (test->enabled()) {
+						rslts->inc(true);
+						round.push_back(test);
+					}
+				}
+			}
 		}
 	}
 
+	if (this->opts_->rerun_failed_under_.cmd().size() > 0) {
+		rslts->rerunFailed();
+	}
+
 	rslts->dump();
+	this->writeResults(*rslts);
 
 	return *rslts;
 }
+
+std::vector<sp<const Test>> Main::leakChecked(std::vector<sp<const Test>> tests,
+											  sp<Remotes> *remotes)
+{
+	char exe[PATH_MAX];
+	auto len = readlink("/proc/self/exe", exe, sizeof(exe) - 1);
+	OSErr(len, {}, "failed to find the test binary");
+	exe[len] = '\0';
+
+	if (*remotes == nullptr) {
+		*remotes = mksp<Remotes>();
+	}
+
+	for (auto &t : tests) {
+		if (t->enabled() && !t->isBenchmark() && t->remote() == nullptr) {
+			t = t->runIn((*remotes)->make(exe, t->name()));
+		}
+	}
+
+	return tests;
+}
+
+std::vector<sp<const Test>> Main::impacted(std::vector<sp<const Test>> tests)
+{
+	std::vector<sp<const Test>> affected;
+	const auto &changed = this->opts_->changed_files_.get();
+	auto map = impact::Map::load(this->opts_->impact_.get());
+
+	for (auto &t : tests) {
+		if (!t->enabled() || map.affected(t->name(), changed)) {
+			affected.push_back(std::move(t));
+		}
+	}
+
+	return affected;
+}
+
+std::vector<sp<const Test>> Main::shard(std::vector<sp<const Test>> tests)
+{
+	size_t i;
+	const auto &shard = this->opts_->shard_;
+	const auto &history = this->opts_->history_.get();
+
+	std::map<std::string, double> durs;
+	if (history.size() > 0 && access(history.c_str(), F_OK) == 0) {
+		for (const auto &r : Results::load(history)) {
+			if (r.enabled() && !r.skipped_) {
+				durs[r.test_name_] = r.duration_;
+			}
+		}
+	}
+
+	// New tests are expected to take as long as the average test
+	double mean = 1.0;
+	if (durs.size() > 0) {
+		mean = 0.0;
+		for (const auto &d : durs) {
+			mean += d.second;
+		}
+		mean /= (double)durs.size();
+	}
+
+	struct Cost {
+		sp<const Test> test_;
+		double cost_;
+	};
+
+	std::vector<Cost> costs;
+	std::vector<sp<const Test>> mine;
+
+	for (auto &t : tests) {
+		if (t->enabled()) {
+			auto it = durs.find(t->name());
+			costs.push_back({ t, it == durs.end() ? mean : it->second });
+		} else if (shard.index() == 0) {
+			// Disabled tests cost nothing, so they only need reporting once
+			mine.push_back(std::move(t));
+		}
+	}
+
+	// Every shard has to come to the same answer, no matter which order the
+	// tests were found in: longest first, then by name.
+	std::sort(costs.begin(), costs.end(), [](const Cost &a, const Cost &b) {
+		if (a.cost_ != b.cost_) {
+			return a.cost_ > b.cost_;
+		}
+
+		return strcmp(a.test_->name(), b.test_->name()) < 0;
+	});
+
+	// Greedily hand each test to the least-loaded shard
+	std::vector<double> loads(shard.count(), 0.0);
+	for (auto &c : costs) {
+		size_t least = 0;
+		for (i = 1; i < loads.size(); i++) {
+			if (loads[i] < loads[least]) {
+				least = i;
+			}
+		}
+
+		loads[least] += c.cost_;
+		if (least == shard.index()) {
+			mine.push_back(std::move(c.test_));
+		}
+	}
+
+	return mine;
+}
+
+void Main::list(std::ostream &os, std::vector<sp<const Test>> tests)
+{
+	std::sort(tests.begin(), tests.end(),
+			  [](const sp<const Test> &a, const sp<const Test> &b) {
+				  return strcmp(a->name(), b->name()) < 0;
+			  });
+
+	for (const auto &t : tests) {
+		if (t->enabled()) {
+			format(os, "%s\t%f\n", t->name(), t->timeout());
+		}
+	}
+}
+
+void Main::writeResults(const Results &rslts)
+{
+	const auto &path = this->opts_->output_.get();
+
+	if (path.size() > 0) {
+		rslts.write(path);
+	}
+
+	const auto &failed = this->opts_->failed_first_.get();
+	if (failed.size() > 0) {
+		rslts.writeFailed(failed);
+	}
+}
 }
 
 int main(int argc, char **argv)
@@ -21,8 +21,39 @@ namespace pt
 class Main
 {
 	sp<Opts> opts_ = mksp<Opts>();
+
+	/**
+	 * Descriptors of the tests in the binary. Tests are only created from
+	 * them once the filters are known.
+	 */
+	std::vector<const _paratec_desc *> descs_;
 	std::vector<sp<const Test>> tests_;
 
+	/**
+	 * Without the leak checking helper loaded, run every test that can be
+	 * checked in another process of this binary that has it. The remote
+	 * tests' results go in the given remotes, created if there aren't any.
+	 */
+	std::vector<sp<const Test>> leakChecked(std::vector<sp<const Test>> tests,
+											sp<Remotes> *remotes);
+
+	/**
+	 * Only keep the tests that depend on the changed files
+	 */
+	std::vector<sp<const Test>> impacted(std::vector<sp<const Test>> tests);
+
+	/**
+	 * Only keep the tests that belong to this shard
+	 */
+	std::vector<sp<const Test>> shard(std::vector<sp<const Test>> tests);
+
+	/**
+	 * Print the enabled tests, one per line, with their timeouts
+	 */
+	void list(std::ostream &os, std::vector<sp<const Test>> tests);
+
+	void writeResults(const Results &rslts);
+
 public:
 	/**
 	 * Use the tests in the binary
@@ -6,10 +6,371 @@
  * http://opensource.org/licenses/MIT
  */
 
+#include <fstream>
+#include <limits.h>
+#include <set>
+#include <unistd.h>
+#include "err.hpp"
+#include "main.hpp"
+#include "util.hpp"
 #include "util_test.hpp"
 
 namespace pt
 {
 
 // @todo test calling run on same pt::Main() multiple times.
+
+TEST(_shard0)
+{
+}
+
+TEST(_shard1)
+{
+}
+
+TEST(_shard2)
+{
+}
+
+TEST(_shard3)
+{
+}
+
+TEST(_shard4)
+{
+}
+
+TEST(_shard5, PTFAIL())
+{
+	pt_fail("expected");
+}
+
+TEST(_remotePass)
+{
+}
+
+TEST(_failedFirst)
+{
+	pt_fail("still broken");
+}
+
+TEST(_remoteFail)
+{
+	pt_fail("remote failure");
+}
+
+static std::vector<sp<const Test>> _shardTests()
+{
+	return {
+		MKTEST(_shard0), MKTEST(_shard1), MKTEST(_shard2),
+		MKTEST(_shard3), MKTEST(_shard4), MKTEST(_shard5),
+	};
+}
+
+static std::set<std::string> _runShard(const char *shard,
+									   const std::string &out_path,
+									   const char *history = "")
+{
+	std::stringstream out;
+	std::set<std::string> names;
+	std::string oarg("--output=" + out_path);
+	std::string harg(std::string("--history=") + history);
+
+	Main m(_shardTests());
+	m.run(out, { "paratec", "--shard", shard, oarg.c_str(), harg.c_str() });
+
+	for (const auto &r : Results::load(out_path)) {
+		if (r.enabled()) {
+			names.insert(r.name_);
+		}
+	}
+
+	return names;
+}
+
+TEST(mainShard)
+{
+	char dir[] = "/tmp/paratec-shard-XXXXXX";
+	pt(mkdtemp(dir) != nullptr);
+
+	auto a_path = std::string(dir) + "/a";
+	auto b_path = std::string(dir) + "/b";
+	DTor d([&]() {
+		unlink(a_path.c_str());
+		unlink(b_path.c_str());
+		rmdir(dir);
+	});
+
+	auto a = _runShard("1/2", a_path);
+	auto b = _runShard("2/2", b_path);
+
+	// Without history, shards are balanced by count
+	pt_eq(a.size(), (size_t)3);
+	pt_eq(b.size(), (size_t)3);
+
+	for (const auto &name : a) {
+		pt(b.count(name) == 0, "%s ran in both shards", name.c_str());
+	}
+
+	// And the same shard is always the same
+	pt(_runShard("1/2", a_path) == a);
+
+	std::stringstream out;
+	std::string marg("--merge-results=" + a_path + "," + b_path);
+
+	Main m(std::vector<sp<const Test>>{});
+	auto rslts = m.run(out, { "paratec", marg.c_str() });
+
+	auto s = out.str();
+	pt_in("100%: of 6 tests run, 6 OK", s);
+	pt_eq(rslts.exitCode(), 0);
+}
+
+TEST(mainShardHistory)
+{
+	char dir[] = "/tmp/paratec-shard-XXXXXX";
+	pt(mkdtemp(dir) != nullptr);
+
+	auto hist = std::string(dir) + "/history";
+	auto out = std::string(dir) + "/out";
+	DTor d([&]() {
+		unlink(hist.c_str());
+		unlink(out.c_str());
+		rmdir(dir);
+	});
+
+	{
+		std::ofstream f(hist);
+		f << "paratec-results-v1\twall=10\n";
+		f << "name=_shard0\ttest=_shard0\tenabled=1\tduration=10\n";
+		for (int i = 1; i < 6; i++) {
+			f << "test=_shard" << i << "\tenabled=1\tduration=0.1\n";
+		}
+	}
+
+	// _shard0 takes as long as everything else put together
+	auto a = _runShard("1/2", out, hist.c_str());
+	auto b = _runShard("2/2", out, hist.c_str());
+
+	pt_eq(a.size() + b.size(), (size_t)6);
+	pt(a.size() == 1 || b.size() == 1);
+	pt((a.size() == 1 ? a : b).count("_shard0") == 1);
+}
+
+TEST(mainShardInvalid, PTEXIT(1))
+{
+	std::stringstream out;
+
+	Main m(std::vector<sp<const Test>>{});
+	m.run(out, { "paratec", "--shard=3/2" });
+}
+
+TEST(mainList)
+{
+	std::stringstream out;
+
+	Main m(_shardTests());
+	auto rslts
+		= m.run(out, { "paratec", "--list", "-t", "3", "-f", "_shard1,_shard2" });
+
+	pt_eq(out.str(), "_shard1\t3.000000\n_shard2\t3.000000\n");
+	pt_eq(rslts.exitCode(), 0);
+}
+
+TEST(mainEmpty)
+{
+	std::stringstream out;
+
+	Main m;
+	m.run(out, { "paratec", "-f", "nothing" });
+
+	pt_in("of 0 tests run", out.str());
+	pt_in("Took 0.000000s", out.str());
+}
+
+TEST(mainEmptyNoFork)
+{
+	std::stringstream out;
+
+	Main m;
+	m.run(out, { "paratec", "-f", "nothing", "--nofork" });
+
+	pt_in("Took 0.000000s", out.str());
+}
+
+TEST(mainBinaries)
+{
+	char bin[PATH_MAX];
+	auto len = readlink("/proc/self/exe", bin, sizeof(bin) - 1);
+	pt(len > 0);
+	bin[len] = '\0';
+
+	std::stringstream out;
+	std::string barg(std::string("--binaries=") + bin);
+	std::string prefix(strrchr(bin, '/') + 1);
+
+	Main m;
+	auto rslts = m.run(out, { "paratec", barg.c_str(), "-f", "*/_remote*" });
+
+	pt_in("of 2 tests run, 1 OK, 0 errors, 1 failures", out.str());
+	pt_eq(rslts.exitCode(), 1);
+
+	auto r = rslts.get(prefix + "/_remoteFail");
+	pt(r.failed_);
+	pt_in("remote failure", r.fail_msg_);
+
+	pt(!rslts.get(prefix + "/_remotePass").failed_);
+}
+
+TEST(mainBinariesBench)
+{
+	char bin[PATH_MAX];
+	auto len = readlink("/proc/self/exe", bin, sizeof(bin) - 1);
+	pt(len > 0);
+	bin[len] = '\0';
+
+	std::stringstream out;
+	std::string barg(std::string("--binaries=") + bin);
+	std::string prefix(strrchr(bin, '/') + 1);
+
+	Main m;
+	auto rslts = m.run(out, { "paratec", barg.c_str(), "-b", "-d", ".01", "-f",
+							  "*/_benchCmp" });
+
+	pt_in("vs slow", out.str());
+
+	auto r = rslts.get(prefix + "/_benchCmp");
+	pt_eq(r.bench_variants_.size(), (size_t)2);
+	pt_gt(r.bench_rounds_, (uint64_t)0);
+}
+
+TEST(mainBinariesSameName)
+{
+	char bin[PATH_MAX];
+	auto len = readlink("/proc/self/exe", bin, sizeof(bin) - 1);
+	pt(len > 0);
+	bin[len] = '\0';
+
+	char dir[] = "/tmp/paratec-binaries-XXXXXX";
+	pt(mkdtemp(dir) != nullptr);
+
+	auto other = std::string(dir) + strrchr(bin, '/');
+	pt_eq(symlink(bin, other.c_str()), 0);
+	DTor d([&]() {
+		unlink(other.c_str());
+		rmdir(dir);
+	});
+
+	std::stringstream out;
+	std::string barg(std::string("--binaries=") + bin + "," + other);
+
+	try {
+		Main m;
+		m.run(out, { "paratec", barg.c_str(), "-f", "*/_remote*" });
+		pt_fail("binaries with the same name were accepted");
+	} catch (Err &e) {
+		pt_in("would both name their tests", e.what());
+	}
+}
+
+TEST(mainBinariesNoFork, PTEXIT(1))
+{
+	std::stringstream out;
+
+	Main m(std::vector<sp<const Test>>{});
+	m.run(out, { "paratec", "--binaries=/bin/true", "--nofork" });
+}
+
+static std::set<std::string> _readFailed(const char *path)
+{
+	std::string name;
+	std::set<std::string> names;
+	std::ifstream f(path);
+
+	while (std::getline(f, name)) {
+		names.insert(name);
+	}
+
+	return names;
+}
+
+TEST(mainFailedFirst)
+{
+	char path[] = "/tmp/paratec-failed-XXXXXX";
+	int fd = mkstemp(path);
+	pt_ne(fd, -1);
+	close(fd);
+
+	DTor d([&]() { unlink(path); });
+
+	{
+		std::ofstream f(path);
+		f << "_failedFirst\n_gone\n";
+	}
+
+	std::stringstream out;
+	std::string farg(std::string("--failed-first=") + path);
+
+	// Only ever runs first if it's remembered
+	Main m({ MKTEST(_shard0), MKTEST(_shard1), MKTEST(_shard2),
+			 MKTEST(_failedFirst) });
+	auto rslts = m.run(out, { "paratec", "-j", "1", "--fail-fast", farg.c_str() });
+
+	pt_eq(rslts.exitCode(), 1);
+	pt_in("1 failures, 0 skipped, 3 not run.", out.str());
+	pt(rslts.get("_failedFirst").failed_);
+
+	// Tests that didn't run are forgotten about
+	pt(_readFailed(path) == std::set<std::string>({ "_failedFirst", "_gone" }));
+}
+
+TEST(mainFailedFirstNoFork)
+{
+	char path[] = "/tmp/paratec-failed-XXXXXX";
+	int fd = mkstemp(path);
+	pt_ne(fd, -1);
+	close(fd);
+
+	DTor d([&]() { unlink(path); });
+
+	{
+		std::ofstream f(path);
+		f << "_failedFirst\n";
+	}
+
+	std::stringstream out;
+	std::string farg(std::string("--failed-first=") + path);
+
+	Main m({ MKTEST(_shard0), MKTEST(_shard1), MKTEST(_shard2),
+			 MKTEST(_failedFirst) });
+	auto rslts = m.run(out, { "paratec", "--nofork", "--fail-fast",
+							  farg.c_str() });
+
+	pt_eq(rslts.exitCode(), 1);
+	pt_in("1 failures, 0 skipped, 3 not run.", out.str());
+}
+
+TEST(mainFailedFirstPassed)
+{
+	char path[] = "/tmp/paratec-failed-XXXXXX";
+	int fd = mkstemp(path);
+	pt_ne(fd, -1);
+	close(fd);
+
+	DTor d([&]() { unlink(path); });
+
+	{
+		std::ofstream f(path);
+		f << "_shard0\n";
+	}
+
+	std::stringstream out;
+	std::string farg(std::string("--failed-first=") + path);
+
+	Main m({ MKTEST(_shard0), MKTEST(_shard1) });
+	auto rslts = m.run(out, { "paratec", farg.c_str() });
+
+	pt_eq(rslts.exitCode(), 0);
+	pt_eq(_readFailed(path).size(), (size_t)0);
+}
 }
@@ -7,17 +7,25 @@
  */
 
 #include <limits>
+#include <sstream>
 #include <stdexcept>
 #include <stdlib.h>
 #include <string.h>
 #include <string>
+#include "cpu.hpp"
 #include "err.hpp"
+#include "leaks.hpp"
 #include "opts.hpp"
 #include "std.hpp"
 
 namespace pt
 {
 
+/**
+ * getopt value given to the first long-only option
+ */
+static constexpr int kLongOnly = 256;
+
 void Opt::showUsage()
 {
 	std::string metavar;
@@ -26,8 +34,13 @@ void Opt::showUsage()
 		metavar = "=" + this->meta_var_;
 	}
 
-	printf(INDENT "-%c%s, --%s%s\n", this->arg_, metavar.c_str(),
-		   this->name_.c_str(), metavar.c_str());
+	if (this->arg_ != 0) {
+		printf(INDENT "-%c%s, --%s%s\n", this->arg_, metavar.c_str(),
+			   this->name_.c_str(), metavar.c_str());
+	} else {
+		printf(INDENT "--%s%s\n", this->name_.c_str(), metavar.c_str());
+	}
+
 	printf(INDENT INDENT "%s\n", this->help_.c_str());
 }
 
@@ -63,6 +76,39 @@ template <> void TypedOpt<uint16_t>::parse(std::string arg)
 	this->set(_stoul<uint16_t>(this->name_, arg));
 }
 
+template <> void TypedOpt<uint64_t>::parse(std::string arg)
+{
+	this->set(_stoul<uint64_t>(this->name_, arg));
+}
+
+void BytesOpt::parse(std::string arg)
+{
+	static const char *kSuffixes = "KMGT";
+
+	uint64_t mult = 1;
+	auto suffix = arg.size() > 0 ? strchr(kSuffixes, toupper(arg.back()))
+								 : nullptr;
+
+	if (suffix != nullptr && *suffix != '\0') {
+		mult = 1ull << (10 * (suffix - kSuffixes + 1));
+		arg.pop_back();
+	}
+
+	// stoul stops at anything it doesn't understand, which would turn a typo
+	// in the suffix into a limit 1000s of times too small
+	if (arg.find_first_not_of("0123456789") != std::string::npos) {
+		Err(-1, "%s: `%s` could not be parsed to a size", this->name_.c_str(),
+			arg.c_str());
+	}
+
+	auto v = _stoul<uint64_t>(this->name_, arg);
+	if (v > std::numeric_limits<uint64_t>::max() / mult) {
+		Err(-1, "%s: `%s` is too large", this->name_.c_str(), arg.c_str());
+	}
+
+	this->set(v * mult);
+}
+
 template <> void TypedOpt<double>::parse(std::string arg)
 {
 	try {
@@ -91,28 +137,129 @@ template <> int TypedOpt<bool>::argType()
 	return no_argument;
 }
 
-void FilterOpt::parse(std::string args)
+void BenchColdOpt::parse(std::string v)
+{
+	if (v.size() > 0 && v != "1" && v != "tlb") {
+		Err(-1, "%s: `%s` must be empty or `tlb`", this->name_.c_str(),
+			v.c_str());
+	}
+
+	this->enabled_ = true;
+	this->set(std::move(v));
+}
+
+void BenchTimerOpt::parse(std::string v)
 {
-	char in[args.size() + 1];
-	char *ary = in;
+	if (v != "clock" && v != "tsc") {
+		Err(-1, "%s: `%s` must be `clock` or `tsc`", this->name_.c_str(),
+			v.c_str());
+	}
 
-	strcpy(in, args.c_str());
+	this->set(std::move(v));
+}
+
+void FailFastOpt::parse(std::string v)
+{
+	this->set(v.size() == 0 ? 1 : _stoul<uint>(this->name_, v));
+}
 
-	while (true) {
-		char *f = strtok(ary, ", ");
-		ary = nullptr;
+void FilterOpt::parse(std::string args)
+{
+	size_t i = 0;
 
-		if (f == nullptr) {
-			break;
+	while (i < args.size()) {
+		if (args[i] == ',' || args[i] == ' ') {
+			i++;
+			continue;
 		}
 
-		bool neg = *f == '-';
+		bool neg = args[i] == '-';
 		if (neg) {
-			f++;
+			i++;
+		}
+
+		// Regexes may contain commas and spaces, so they run to the next
+		// slash that ends a filter.
+		size_t end;
+		if (i < args.size() && args[i] == '/') {
+			end = i + 1;
+			while (true) {
+				end = args.find('/', end);
+				if (end == std::string::npos) {
+					end = args.size();
+					break;
+				}
+
+				end++;
+				if (end == args.size() || args[end] == ','
+					|| args[end] == ' ') {
+					break;
+				}
+			}
+		} else {
+			end = args.find_first_of(", ", i);
+			if (end == std::string::npos) {
+				end = args.size();
+			}
+		}
+
+		if (end > i) {
+			this->filts_.add(neg, args.substr(i, end - i));
+		}
+
+		i = end;
+	}
+}
+
+void StrListOpt::parse(std::string val)
+{
+	size_t start = 0;
+
+	while (start <= val.size()) {
+		auto end = val.find(',', start);
+		if (end == std::string::npos) {
+			end = val.size();
+		}
+
+		if (end > start) {
+			this->v_.push_back(val.substr(start, end - start));
 		}
 
-		this->filts_.emplace_back(neg, f);
+		start = end + 1;
+	}
+}
+
+void RerunFailedUnderOpt::parse(std::string val)
+{
+	std::string word;
+	std::istringstream is(val);
+
+	this->cmd_.clear();
+	while (is >> word) {
+		this->cmd_.push_back(word);
+	}
+
+	this->set(std::move(val));
+}
+
+void ShardOpt::parse(std::string val)
+{
+	auto slash = val.find('/');
+	if (slash == std::string::npos) {
+		Err(-1, "%s: `%s` must look like I/N", this->name_.c_str(),
+			val.c_str());
+	}
+
+	auto i = _stoul<uint>(this->name_, val.substr(0, slash));
+	auto n = _stoul<uint>(this->name_, val.substr(slash + 1));
+
+	if (n == 0 || i == 0 || i > n) {
+		Err(-1, "%s: `%s` must have 1 <= I <= N", this->name_.c_str(),
+			val.c_str());
 	}
+
+	this->index_ = i - 1;
+	this->count_ = n;
 }
 
 void HelpOpt::parse(std::string)
@@ -137,9 +284,19 @@ void HelpOpt::usage(const std::vector<const char *> &args,
 std::vector<Opt *> Opts::getOpts()
 {
 	return {
-		&this->bench_,   &this->bench_dur_,  &this->filter_,  &this->help_,
-		&this->jobs_,	&this->no_capture_, &this->no_fork_, &this->port_,
-		&this->timeout_, &this->verbose_,
+		&this->bench_,		   &this->bench_cold_,	 &this->bench_dur_,
+		&this->bench_layouts_, &this->bench_profile_,  &this->bench_timer_,
+		&this->binaries_,	   &this->cache_,		   &this->cgroup_,
+		&this->changed_files_, &this->count_,		   &this->cov_lock_,
+		&this->cpu_max_,	   &this->fail_fast_,	   &this->failed_first_,
+		&this->filter_,		   &this->help_,		   &this->history_,
+		&this->impact_,		   &this->jobs_,		   &this->jobs_min_,
+		&this->leaks_,		   &this->list_,		   &this->load_,
+		&this->mem_budget_,	   &this->memory_max_,	   &this->merge_results_,
+		&this->no_capture_,	   &this->no_fork_,	   &this->output_,
+		&this->pids_max_,	   &this->pin_,		   &this->port_,
+		&this->record_impact_, &this->rerun_failed_under_, &this->shard_,
+		&this->timeout_,	   &this->until_fail_,	   &this->verbose_,
 	};
 }
 
@@ -160,6 +317,94 @@ void Opts::parse(std::vector<const char *> args)
 		this->tryParse(args, opts);
 		this->capture_ = !this->no_capture_.get();
 		this->fork_ = !this->no_fork_.get();
+
+		// Other binaries' tests are run by exec()ing them, which can only
+		// be done from a forked test.
+		if (this->binaries_.get().size() > 0 && !this->fork_) {
+			Err(-1, "%s can't be used with %s", this->binaries_.name_.c_str(),
+				this->no_fork_.name_.c_str());
+		}
+
+		// Footprints are collected from forked tests
+		if (this->record_impact_.get() && !this->fork_) {
+			Err(-1, "%s can't be used with %s",
+				this->record_impact_.name_.c_str(),
+				this->no_fork_.name_.c_str());
+		}
+
+		// Leaks are only ever tracked in forked tests, where nothing else
+		// in the process can be allocating
+		if (this->leaks_.get() && !this->fork_) {
+			Err(-1, "%s can't be used with %s", this->leaks_.name_.c_str(),
+				this->no_fork_.name_.c_str());
+		}
+
+		if (this->leaks_.get() && !leaks::kSupported) {
+			Err(-1, "%s isn't supported on this platform",
+				this->leaks_.name_.c_str());
+		}
+
+		// Each job's slot is only ever used by its forked tests
+		if (this->pin_.get() && !this->fork_) {
+			Err(-1, "%s can't be used with %s", this->pin_.name_.c_str(),
+				this->no_fork_.name_.c_str());
+		}
+
+		if (this->pin_.get() && !cpu::kPinSupported) {
+			Err(-1, "%s isn't supported on this platform",
+				this->pin_.name_.c_str());
+		}
+
+		// Limits are enforced by the cgroups
+		const std::pair<const Opt *, bool> limits[] = {
+			{ &this->memory_max_, this->memory_max_.get() > 0 },
+			{ &this->cpu_max_, this->cpu_max_.get() > 0 },
+			{ &this->pids_max_, this->pids_max_.get() > 0 },
+		};
+
+		for (const auto &limit : limits) {
+			if (limit.second && !this->cgroup_.get()) {
+				Err(-1, "%s needs %s", limit.first->name_.c_str(),
+					this->cgroup_.name_.c_str());
+			}
+		}
+
+		// Replicas of a test would all come from the cache
+		const std::pair<const Opt *, bool> repeats[] = {
+			{ &this->count_, this->count_.get() > 1 },
+			{ &this->until_fail_, this->until_fail_.get() },
+		};
+
+		for (const auto &repeat : repeats) {
+			if (repeat.second && this->cache_.get().size() > 0) {
+				Err(-1, "%s can't be used with %s",
+					repeat.first->name_.c_str(), this->cache_.name_.c_str());
+			}
+		}
+
+		// Repeating until something fails stops as soon as it does
+		if (this->until_fail_.get() && this->fail_fast_.get() == 0) {
+			this->fail_fast_.set(1);
+		}
+
+		if (this->jobs_min_.get() > this->jobs_.get()) {
+			Err(-1, "%s can't be more than %s", this->jobs_min_.name_.c_str(),
+				this->jobs_.name_.c_str());
+		}
+
+		if (this->cgroup_.get() && !this->fork_) {
+			Err(-1, "%s can't be used with %s", this->cgroup_.name_.c_str(),
+				this->no_fork_.name_.c_str());
+		}
+
+		if ((this->record_impact_.get()
+			 || this->changed_files_.get().size() > 0)
+			&& this->impact_.get().size() == 0) {
+			Err(-1, "%s and %s need an %s map",
+				this->record_impact_.name_.c_str(),
+				this->changed_files_.name_.c_str(),
+				this->impact_.name_.c_str());
+		}
 	} catch (Err err) {
 		this->usage(err, args, opts);
 	}
@@ -178,22 +423,28 @@ void Opts::tryParse(const std::vector<const char *> &args,
 
 	i = 0;
 	for (auto opt : opts) {
-		auto lopt = &lopts[i++];
+		auto lopt = &lopts[i];
 
 		lopt->name = opt->name_.c_str();
-		lopt->val = opt->arg_;
+		lopt->has_arg = opt->argType();
 
-		optstr += opt->arg_;
+		// Long-only options get a value outside of the range of chars so
+		// that getopt can't confuse them with short options.
+		lopt->val = opt->arg_ != 0 ? opt->arg_ : kLongOnly + i;
+		i++;
 
-		lopt->has_arg = opt->argType();
-		switch (lopt->has_arg) {
-		case required_argument:
-			optstr += ':';
-			break;
+		if (opt->arg_ != 0) {
+			optstr += opt->arg_;
 
-		case optional_argument:
-			optstr += "::";
-			break;
+			switch (lopt->has_arg) {
+			case required_argument:
+				optstr += ':';
+				break;
+
+			case optional_argument:
+				optstr += "::";
+				break;
+			}
 		}
 
 		char *v = getenv(opt->env_.c_str());
@@ -212,12 +463,12 @@ void Opts::tryParse(const std::vector<const char *> &args,
 		}
 
 		bool found = false;
-		for (auto opt : opts) {
-			if (opt->arg_ != c) {
+		for (i = 0; i < (int)opts.size(); i++) {
+			if (lopts[i].val != c) {
 				continue;
 			}
 
-			opt->parse(optarg ?: "");
+			opts[(size_t)i]->parse(optarg ?: "");
 
 			found = true;
 			break;
@@ -13,6 +13,7 @@
 #include <vector>
 #include <unistd.h>
 #include "err.hpp"
+#include "filter.hpp"
 #include "std.hpp"
 
 namespace pt
@@ -32,6 +33,10 @@ protected:
 
 public:
 	const std::string name_;
+
+	/**
+	 * Short option; 0 if the option only has a long form
+	 */
 	const char arg_;
 	const std::string env_;
 	const std::string meta_var_;
@@ -52,7 +57,7 @@ public:
 template <typename T> class TypedOpt : public Opt
 {
 protected:
-	T v_ = 0;
+	T v_ = T();
 
 protected:
 	TypedOpt(std::string name, char arg, std::string env, std::string help)
@@ -106,6 +111,93 @@ public:
 	void parse(std::string v) override;
 };
 
+/**
+ * An option that just holds onto whatever string it was given
+ */
+class StrOpt : public Opt
+{
+protected:
+	std::string v_;
+
+	StrOpt(std::string name,
+		   char arg,
+		   std::string env,
+		   std::string meta,
+		   std::string help)
+		: Opt(std::move(name),
+			  arg,
+			  std::move(env),
+			  std::move(meta),
+			  std::move(help))
+	{
+	}
+
+public:
+	inline const std::string &get() const
+	{
+		return this->v_;
+	}
+
+	inline void set(std::string v)
+	{
+		this->v_ = std::move(v);
+	}
+
+	void parse(std::string v) override
+	{
+		this->set(std::move(v));
+	}
+};
+
+/**
+ * An option that takes a comma-separated list of values
+ */
+class StrListOpt : public Opt
+{
+protected:
+	std::vector<std::string> v_;
+
+	StrListOpt(std::string name,
+			   char arg,
+			   std::string env,
+			   std::string meta,
+			   std::string help)
+		: Opt(std::move(name),
+			  arg,
+			  std::move(env),
+			  std::move(meta),
+			  std::move(help))
+	{
+	}
+
+public:
+	inline const std::vector<std::string> &get() const
+	{
+		return this->v_;
+	}
+
+	void parse(std::string val) override;
+};
+
+/**
+ * A number of bytes, optionally with a K, M, G, or T suffix (powers of 1024)
+ */
+class BytesOpt : public TypedOpt<uint64_t>
+{
+protected:
+	BytesOpt(std::string name, std::string env, std::string help)
+		: TypedOpt<uint64_t>(std::move(name),
+							 0,
+							 std::move(env),
+							 std::string("BYTES"),
+							 std::move(help))
+	{
+	}
+
+public:
+	void parse(std::string v) override;
+};
+
 class BenchOpt : public TypedOpt<bool>
 {
 public:
@@ -114,6 +206,39 @@ public:
 	}
 };
 
+class BenchColdOpt : public StrOpt
+{
+	bool enabled_ = false;
+
+public:
+	BenchColdOpt()
+		: StrOpt("bench-cold",
+				 0,
+				 "PTBENCHCOLD",
+				 "[tlb]",
+				 "flush the caches before every round of a benchmark; with "
+				 "`tlb`, flush the TLB, too")
+	{
+	}
+
+	void parse(std::string v) override;
+
+	int argType() override
+	{
+		return optional_argument;
+	}
+
+	inline bool enabled() const
+	{
+		return this->enabled_;
+	}
+
+	inline bool tlb() const
+	{
+		return this->v_ == "tlb";
+	}
+};
+
 class BenchDurOpt : public TypedOpt<double>
 {
 public:
@@ -127,37 +252,223 @@ public:
 	}
 };
 
-class FilterOpt : public Opt
+class BenchLayoutsOpt : public TypedOpt<uint>
 {
 public:
-	struct F {
-		bool neg_;
-		std::string f_;
+	BenchLayoutsOpt()
+		: TypedOpt<uint>("bench-layouts",
+						 0,
+						 "PTBENCHLAYOUTS",
+						 "N",
+						 "run each benchmark in N processes with randomized "
+						 "stack and heap layouts")
+	{
+	}
+};
 
-		F(bool neg, std::string f) : neg_(neg), f_(std::move(f))
-		{
-		}
+class BenchProfileOpt : public StrOpt
+{
+public:
+	BenchProfileOpt()
+		: StrOpt("bench-profile",
+				 0,
+				 "PTBENCHPROFILE",
+				 "DIR",
+				 "sample benchmarks while they run and write folded stacks "
+				 "into DIR")
+	{
+	}
+};
 
-		const char *c_str() const
-		{
-			return this->f_.c_str();
-		}
-	};
+class BenchTimerOpt : public StrOpt
+{
+public:
+	BenchTimerOpt()
+		: StrOpt("bench-timer",
+				 0,
+				 "PTBENCHTIMER",
+				 "clock",
+				 "time benchmarks with `clock` (clock_gettime) or `tsc` "
+				 "(falls back to `clock` without an invariant TSC)")
+	{
+		this->v_ = "clock";
+	}
+
+	void parse(std::string v) override;
+
+	inline bool tsc() const
+	{
+		return this->v_ == "tsc";
+	}
+};
+
+class BinariesOpt : public StrListOpt
+{
+public:
+	BinariesOpt()
+		: StrListOpt("binaries",
+					 0,
+					 "PTBINARIES",
+					 "BIN,...",
+					 "run the tests of the given paratec binaries, instead of "
+					 "this one, from a single pool of jobs")
+	{
+	}
+};
+
+class CacheOpt : public StrOpt
+{
+public:
+	CacheOpt()
+		: StrOpt("cache",
+				 0,
+				 "PTCACHE",
+				 "DIR",
+				 "remember tests that passed in DIR, and don't run them again "
+				 "until their binary, inputs, or options change")
+	{
+	}
+};
+
+class CgroupOpt : public TypedOpt<bool>
+{
+public:
+	CgroupOpt()
+		: TypedOpt<bool>("cgroup",
+						 0,
+						 "PTCGROUP",
+						 "run every forked test in its own cgroup, recording what "
+						 "it used and killing everything it left behind")
+	{
+	}
+};
+
+class ChangedFilesOpt : public StrListOpt
+{
+public:
+	ChangedFilesOpt()
+		: StrListOpt("changed-files",
+					 0,
+					 "PTCHANGEDFILES",
+					 "FILE,...",
+					 "only run the tests that depend on the given source files, "
+					 "according to the --impact map")
+	{
+	}
+};
+
+class CountOpt : public TypedOpt<uint>
+{
+public:
+	CountOpt()
+		: TypedOpt<uint>("count",
+						 0,
+						 "PTCOUNT",
+						 "N",
+						 "run every test N times, reporting how often each "
+						 "failed")
+	{
+	}
+};
+
+class CpuMaxOpt : public TypedOpt<double>
+{
+public:
+	CpuMaxOpt()
+		: TypedOpt<double>("cpu-max",
+						   0,
+						   "PTCPU_MAX",
+						   std::string("CPUS"),
+						   "with --cgroup, limit every test to this many CPUs "
+						   "worth of time")
+	{
+	}
+};
+
+class CovLockOpt : public TypedOpt<bool>
+{
+public:
+	CovLockOpt()
+		: TypedOpt<bool>("cov-lock",
+						 0,
+						 "PTCOVLOCK",
+						 "let only one forked test at a time write its coverage "
+						 "data, for coverage runtimes that aren't fork-safe")
+	{
+	}
+};
+
+class FailFastOpt : public TypedOpt<uint>
+{
+public:
+	FailFastOpt()
+		: TypedOpt<uint>("fail-fast",
+						 0,
+						 "PTFAIL_FAST",
+						 "[N]",
+						 "stop running tests after N (default: 1) have failed")
+	{
+	}
+
+	void parse(std::string v) override;
+
+	int argType() override
+	{
+		return optional_argument;
+	}
+};
+
+class FailedFirstOpt : public StrOpt
+{
+public:
+	FailedFirstOpt()
+		: StrOpt("failed-first",
+				 0,
+				 "PTFAILEDFIRST",
+				 "FILE",
+				 "remember the tests that failed in FILE, and run them first "
+				 "next time")
+	{
+	}
+};
 
-	std::vector<F> filts_;
+class FilterOpt : public Opt
+{
+	Filter filts_;
 
+public:
 	FilterOpt()
 		: Opt("filter",
 			  'f',
 			  "PTFILTER",
 			  "<FILTER>...",
-			  "only run tests prefixed with FILTER")
+			  "only run tests prefixed with FILTER, or matching FILTER if "
+			  "it's a glob or a /regex/")
+	{
+	}
+
+	inline const Filter &get() const
 	{
+		return this->filts_;
 	}
 
 	void parse(std::string val) override;
 };
 
+class HistoryOpt : public StrOpt
+{
+public:
+	HistoryOpt()
+		: StrOpt("history",
+				 0,
+				 "PTHISTORY",
+				 "FILE",
+				 "results file from a previous run, used to balance shards "
+				 "and budget memory")
+	{
+	}
+};
+
 class HelpOpt : public TypedOpt<bool>
 {
 public:
@@ -170,6 +481,19 @@ public:
 							const std::vector<Opt *> &opts);
 };
 
+class ImpactOpt : public StrOpt
+{
+public:
+	ImpactOpt()
+		: StrOpt("impact",
+				 0,
+				 "PTIMPACT",
+				 "FILE",
+				 "map of the source files each test depends on")
+	{
+	}
+};
+
 class JobsOpt : public TypedOpt<uint>
 {
 public:
@@ -185,6 +509,95 @@ public:
 	}
 };
 
+class JobsMinOpt : public TypedOpt<uint>
+{
+public:
+	JobsMinOpt()
+		: TypedOpt<uint>("jobs-min",
+						 0,
+						 "PTJOBSMIN",
+						 "N",
+						 "adapt the number of parallel tests to system pressure, "
+						 "between this and --jobs")
+	{
+	}
+};
+
+class LeaksOpt : public TypedOpt<bool>
+{
+public:
+	LeaksOpt()
+		: TypedOpt<bool>("leaks",
+						 0,
+						 "PTLEAKS",
+						 "fail forked tests that don't free everything they "
+						 "allocate")
+	{
+	}
+};
+
+class ListOpt : public TypedOpt<bool>
+{
+public:
+	ListOpt()
+		: TypedOpt<bool>("list",
+						 0,
+						 "PTLIST",
+						 "instead of running tests, list the tests that would "
+						 "run, with their timeouts")
+	{
+	}
+};
+
+class LoadOpt : public StrListOpt
+{
+public:
+	LoadOpt()
+		: StrListOpt("load",
+					 0,
+					 "PTLOAD",
+					 "SO,...",
+					 "also run the tests in the given shared objects")
+	{
+	}
+};
+
+class MemBudgetOpt : public BytesOpt
+{
+public:
+	MemBudgetOpt()
+		: BytesOpt("mem-budget",
+				   "PTMEMBUDGET",
+				   "only run as many tests at once as fit in this much memory")
+	{
+	}
+};
+
+class MemoryMaxOpt : public BytesOpt
+{
+public:
+	MemoryMaxOpt()
+		: BytesOpt("memory-max",
+				   "PTMEMORY_MAX",
+				   "with --cgroup, limit every test to this much memory")
+	{
+	}
+};
+
+class MergeResultsOpt : public StrListOpt
+{
+public:
+	MergeResultsOpt()
+		: StrListOpt("merge-results",
+					 0,
+					 "PTMERGERESULTS",
+					 "FILE,...",
+					 "instead of running tests, combine the given results "
+					 "files into one summary")
+	{
+	}
+};
+
 class NoCaptureOpt : public TypedOpt<bool>
 {
 public:
@@ -210,6 +623,45 @@ public:
 	}
 };
 
+class OutputOpt : public StrOpt
+{
+public:
+	OutputOpt()
+		: StrOpt("output",
+				 'o',
+				 "PTOUTPUT",
+				 "FILE",
+				 "write machine-readable results to FILE")
+	{
+	}
+};
+
+class PidsMaxOpt : public TypedOpt<uint64_t>
+{
+public:
+	PidsMaxOpt()
+		: TypedOpt<uint64_t>("pids-max",
+							 0,
+							 "PTPIDS_MAX",
+							 std::string("N"),
+							 "with --cgroup, limit every test to this many "
+							 "processes and threads")
+	{
+	}
+};
+
+class PinOpt : public TypedOpt<bool>
+{
+public:
+	PinOpt()
+		: TypedOpt<bool>("pin",
+						 0,
+						 "PTPIN",
+						 "pin each job to its own CPUs and NUMA node")
+	{
+	}
+};
+
 class PortOpt : public TypedOpt<uint16_t>
 {
 	static constexpr uint16_t kPort = 23120;
@@ -225,6 +677,76 @@ public:
 	}
 };
 
+class RecordImpactOpt : public TypedOpt<bool>
+{
+public:
+	RecordImpactOpt()
+		: TypedOpt<bool>("record-impact",
+						 0,
+						 "PTRECORDIMPACT",
+						 "record the source files each test depends on into the "
+						 "--impact map")
+	{
+	}
+};
+
+class RerunFailedUnderOpt : public StrOpt
+{
+	std::vector<std::string> cmd_;
+
+public:
+	RerunFailedUnderOpt()
+		: StrOpt("rerun-failed-under",
+				 0,
+				 "PTRERUNFAILEDUNDER",
+				 "CMD",
+				 "once all tests have run, run each that failed again under "
+				 "CMD, where {} is the binary (eg. `valgrind {}`)")
+	{
+	}
+
+	/**
+	 * The command, split into words. Empty if not rerunning anything.
+	 */
+	inline const std::vector<std::string> &cmd() const
+	{
+		return this->cmd_;
+	}
+
+	void parse(std::string v) override;
+};
+
+class ShardOpt : public Opt
+{
+	uint index_ = 0;
+	uint count_ = 1;
+
+public:
+	ShardOpt()
+		: Opt("shard",
+			  0,
+			  "PTSHARD",
+			  "I/N",
+			  "only run the I-th of N evenly-balanced shards of the tests")
+	{
+	}
+
+	void parse(std::string val) override;
+
+	/**
+	 * Which shard to run, starting from 0
+	 */
+	inline uint index() const
+	{
+		return this->index_;
+	}
+
+	inline uint count() const
+	{
+		return this->count_;
+	}
+};
+
 class TimeoutOpt : public TypedOpt<double>
 {
 	static constexpr double kTimeout = 5.0;
@@ -240,6 +762,19 @@ public:
 	}
 };
 
+class UntilFailOpt : public TypedOpt<bool>
+{
+public:
+	UntilFailOpt()
+		: TypedOpt<bool>("until-fail",
+						 0,
+						 "PTUNTILFAIL",
+						 "run every test again and again until one fails "
+						 "(at most --count times)")
+	{
+	}
+};
+
 class VerboseOpt : public TypedOpt<uint>
 {
 public:
@@ -307,14 +842,43 @@ public:
 	bool fork_;
 
 	BenchOpt bench_;
+	BenchColdOpt bench_cold_;
 	BenchDurOpt bench_dur_;
+	BenchLayoutsOpt bench_layouts_;
+	BenchProfileOpt bench_profile_;
+	BenchTimerOpt bench_timer_;
+	BinariesOpt binaries_;
+	CacheOpt cache_;
+	CgroupOpt cgroup_;
+	ChangedFilesOpt changed_files_;
+	CountOpt count_;
+	CovLockOpt cov_lock_;
+	CpuMaxOpt cpu_max_;
+	FailFastOpt fail_fast_;
+	FailedFirstOpt failed_first_;
 	FilterOpt filter_;
 	HelpOpt help_;
+	HistoryOpt history_;
+	ImpactOpt impact_;
 	JobsOpt jobs_;
+	JobsMinOpt jobs_min_;
+	LeaksOpt leaks_;
+	ListOpt list_;
+	LoadOpt load_;
+	MemBudgetOpt mem_budget_;
+	MemoryMaxOpt memory_max_;
+	MergeResultsOpt merge_results_;
 	NoCaptureOpt no_capture_;
 	NoForkOpt no_fork_;
+	OutputOpt output_;
+	PidsMaxOpt pids_max_;
+	PinOpt pin_;
 	PortOpt port_;
+	RecordImpactOpt record_impact_;
+	RerunFailedUnderOpt rerun_failed_under_;
+	ShardOpt shard_;
 	TimeoutOpt timeout_;
+	UntilFailOpt until_fail_;
 	VerboseOpt verbose_;
 
 	/**
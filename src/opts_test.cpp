@@ -59,7 +59,63 @@ TEST(optsFilter)
 	Opts opts;
 	opts.parse({ "paratec", "--filter=1,-2", "-f", "3,4", "-f", "5" });
 
-	// pt::eq(opts.filter_.filts_, std::vector<FilterOpt::F>({}));
+	// 1 from the environment, 5 from the args
+	pt_eq(opts.filter_.get().size(), (size_t)6);
+}
+
+TEST(optsEnvLimits)
+{
+	setenv("PTFAIL_FAST", "2", 1);
+	setenv("PTMEMORY_MAX", "1024", 1);
+
+	Opts opts;
+	opts.parse({ "paratec", "--cgroup" });
+
+	pt_eq(opts.fail_fast_.get(), (uint)2);
+	pt_eq(opts.memory_max_.get(), (uint64_t)1024);
+}
+
+TEST(optsFilterMayMatch)
+{
+	Opts opts;
+	opts.parse({ "paratec", "-f", "abc,iter:3,-abcd" });
+
+	pt(opts.filter_.get().mayMatch("abc"));
+	pt(opts.filter_.get().mayMatch("abce"));
+	pt(opts.filter_.get().mayMatch("iter"));
+	pt(!opts.filter_.get().mayMatch("abcd"));
+	pt(!opts.filter_.get().mayMatch("abcde"));
+	pt(!opts.filter_.get().mayMatch("ab"));
+	pt(!opts.filter_.get().mayMatch("ite"));
+	pt(!opts.filter_.get().mayMatch("other"));
+
+	Opts neg;
+	neg.parse({ "paratec", "-f", "-abc" });
+	pt(neg.filter_.get().mayMatch("other"));
+	pt(!neg.filter_.get().mayMatch("abc:1"));
+}
+
+TEST(optsLongOnly)
+{
+	Opts opts;
+	opts.parse({ "paratec", "--bench-profile=/tmp/prof", "-j", "2" });
+	pt_eq(opts.bench_profile_.get(), "/tmp/prof");
+	pt_eq(opts.jobs_.get(), (uint)2);
+}
+
+TEST(optsBenchTimer)
+{
+	Opts opts;
+	pt(!opts.bench_timer_.tsc());
+
+	opts.parse({ "paratec", "--bench-timer=tsc" });
+	pt(opts.bench_timer_.tsc());
+}
+
+TEST(optsBenchTimerInvalid, PTEXIT(1))
+{
+	Opts opts;
+	opts.parse({ "paratec", "--bench-timer=sundial" });
 }
 
 TEST(optsJobs)
@@ -113,4 +169,26 @@ TEST(optsTimeoutLimits, PTEXIT(1))
 	auto max = "99" + std::to_string(std::numeric_limits<double>::max());
 	opts.parse({ "paratec", "-t", max.c_str() });
 }
+
+static struct {
+	const char *arg_;
+	uint64_t bytes_;
+} _bytes[] = {
+	{ "--memory-max=1000", 1000 },
+	{ "--memory-max=64k", 64 * 1024 },
+	{ "--memory-max=3G", 3ull << 30 },
+};
+
+TESTV(optsBytes, _bytes)
+{
+	Opts opts;
+	opts.parse({ "paratec", "--cgroup", _t->arg_ });
+	pt_eq(opts.memory_max_.get(), _t->bytes_);
+}
+
+TEST(optsBytesInvalid, PTEXIT(1))
+{
+	Opts opts;
+	opts.parse({ "paratec", "--cgroup", "--memory-max=10Q" });
+}
 }
@@ -36,19 +36,27 @@
 #define __PT_TEST(test_fn) __paratec_fn_##test_fn
 #define __PT_STRUCT(test_fn) __paratec_obj_##test_fn
 #define __PT_PTR(test_fn) __paratec_sobj_##test_fn
+#define __PT_INIT(test_fn) __paratec_init_##test_fn
 
+/*
+ * Test descriptors are constant-initialized, so nothing runs at load time.
+ * The modifiers given to a test only run, from its init function, once the
+ * test has been selected to run.
+ */
 #define __PARATEC(test_fn, ...)                                                \
-	static struct _paratec __PT_STRUCT(test_fn);                               \
-	static struct _paratec *__PT_PTR(test_fn)                                  \
-		__attribute__((used, section(PT_SECTION))) = &__PT_STRUCT(test_fn);    \
-	static __attribute__((constructor)) void __paratec_##test_fn##_ctor(void)  \
+	static void __PT_INIT(test_fn)(struct _paratec * p)                        \
 	{                                                                          \
-		struct _paratec *p = __PT_PTR(test_fn);                                \
-		p->fn_name_ = PT_STR(__PT_TEST(test_fn));                              \
-		p->name_ = PT_STR(test_fn);                                            \
-		p->fn_ = (void (*)(int64_t, uint32_t, void *))__PT_TEST(test_fn);      \
+		(void)p;                                                               \
 		__VA_ARGS__;                                                           \
-	};
+	}                                                                          \
+	static const struct _paratec_desc __PT_STRUCT(test_fn) = {                 \
+		PT_STR(__PT_TEST(test_fn)),                                            \
+		PT_STR(test_fn),                                                       \
+		(void (*)(int64_t, uint32_t, void *))__PT_TEST(test_fn),               \
+		__PT_INIT(test_fn),                                                    \
+	};                                                                         \
+	static const struct _paratec_desc *__PT_PTR(test_fn)                       \
+		__attribute__((used, section(PT_SECTION))) = &__PT_STRUCT(test_fn);
 
 /**
  * Run a unit test.
@@ -124,6 +132,95 @@
  */
 #define PTBENCH() p->bench_ = 1
 
+/**
+ * Prepare state for a benchmark once, before any of its rounds run. The
+ * function must be of type `void *(*fn)(void)`; whatever it returns is
+ * available to the benchmark from pt_get_bench_state().
+ */
+#define PTBENCHUP(fn) p->bench_setup_ = fn
+
+/**
+ * Tear down a benchmark's state once all of its rounds have finished. The
+ * function must be of type `void (*fn)(void *)`, and it's given the state
+ * returned from the PTBENCHUP function.
+ */
+#define PTBENCHDOWN(fn) p->bench_teardown_ = fn
+
+/**
+ * This test is a benchmark that compares the given variants, which are given
+ * as a string of comma-separated names: the first is the baseline. The
+ * variants are run, alternating, in the same process, and the index of the
+ * variant to run is passed as `_i`. May not be used with PTI().
+ */
+#define PTCMP(variants) p->bench_ = 1, p->cmp_ = variants
+
+/**
+ * This test is a benchmark that is run once for each level of the memory
+ * hierarchy (L1, L2, L3, DRAM). The size of the working set the benchmark
+ * should use at each level is available from pt_get_bench_wss(); its
+ * PTBENCHUP function is run again for each level. May not be used with
+ * PTCMP().
+ */
+#define PTSWEEP() p->bench_ = 1, p->sweep_ = 1
+
+/**
+ * Files this test reads, given as a string of comma-separated paths. When
+ * results are cached (see --cache), the test is only run again if one of the
+ * files changes, along with the binary.
+ */
+#define PTINPUT(files) p->inputs_ = files
+
+/**
+ * Limits on the cgroup the test runs in (see --cgroup): the most memory it
+ * may use, in bytes; how many CPUs worth of time it may use; and how many
+ * processes and threads it may have at once.
+ */
+#define PTMEMORYMAX(bytes) p->memory_max_ = bytes
+#define PTCPUMAX(cpus) p->cpu_max_ = cpus
+#define PTPIDSMAX(n) p->pids_max_ = n
+
+/**
+ * How much memory the test is expected to use at its peak, in bytes. Used to
+ * keep the tests running at once within --mem-budget until a --history file
+ * knows better.
+ */
+#define PTMEM(bytes) p->mem_ = bytes
+
+/**
+ * How many CPUs the test keeps busy, out of the --jobs that may be busy at
+ * once. Tests with worker threads should say so, or the machine ends up
+ * oversubscribed.
+ */
+#define PTCPUS(n) p->cpus_ = n
+
+/**
+ * Run the test with nothing else running
+ */
+#define PTSERIAL() p->serial_ = 1
+
+/**
+ * Most resources a single test may use
+ */
+#define PT_MAX_RES 4
+
+/**
+ * The test uses the named resource (a database, a device, ...), and no more
+ * than `count` tests using it may run at once. When tests disagree on the
+ * count, the smallest wins. Give a test that uses more than one resource a
+ * PTRES() for each; it only runs once it can hold all of them.
+ */
+#define PTRES(name, count)                                                     \
+	(p->nres_ < PT_MAX_RES                                                     \
+		 ? (void)(p->res_[p->nres_] = name, p->res_count_[p->nres_] = count)   \
+		 : (void)0),                                                           \
+		p->nres_++
+
+/**
+ * Once an iteration of a PTI test fails, don't bother with the rest of its
+ * range: they're reported as not run.
+ */
+#define PTFAILFAST() p->fail_fast_ = 1
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -153,6 +250,18 @@ const char *pt_get_name(void);
  */
 PT_PRINTF(1, 2) void pt_set_iter_name(const char *format, ...);
 
+/**
+ * Get the state prepared by the benchmark's PTBENCHUP function. The same
+ * state is shared by every round of the benchmark.
+ */
+void *pt_get_bench_state(void);
+
+/**
+ * Get the working set size, in bytes, that a PTSWEEP benchmark should use;
+ * 0 for every other benchmark.
+ */
+size_t pt_get_bench_wss(void);
+
 /**
  * Used internally by paratec. Don't mess with any of this.
  */
@@ -173,6 +282,32 @@ struct _paratec {
 	void (*setup_)(void);
 	void (*teardown_)(void);
 	void (*cleanup_)(void);
+	void *(*bench_setup_)(void);
+	void (*bench_teardown_)(void *);
+	const char *cmp_;
+	int sweep_;
+	const char *inputs_;
+	uint64_t memory_max_;
+	double cpu_max_;
+	uint64_t pids_max_;
+	uint64_t mem_;
+	int cpus_;
+	int serial_;
+	const char *res_[PT_MAX_RES];
+	int res_count_[PT_MAX_RES];
+	int nres_;
+	int fail_fast_;
+};
+
+/**
+ * What's put into the paratec section for each test. It's fully known at
+ * compile time; the rest of the test is filled in by `init_`.
+ */
+struct _paratec_desc {
+	const char *fn_name_;
+	const char *name_;
+	void (*fn_)(int64_t, uint32_t, void *);
+	void (*init_)(struct _paratec *);
 };
 
 __attribute__((noreturn)) PT_PRINTF(1, 2) void _pt_fail(const char *msg, ...);
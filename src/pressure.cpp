@@ -0,0 +1,106 @@
+/**
+ * @author Andrew Stone <a@stoney.io>
+ * @copyright 2016 Andrew Stone
+ *
+ * This file is part of paratec and is released under the MIT License:
+ * http://opensource.org/licenses/MIT
+ */
+
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include "pressure.hpp"
+
+namespace pt
+{
+
+/**
+ * Past this, the system is stalling: run fewer tests
+ */
+static constexpr double kHighPressure = 0.40;
+
+/**
+ * Under this, there's room for more
+ */
+static constexpr double kLowPressure = 0.10;
+
+static const char *kFiles[Pressure::kResources] = {
+	"/proc/pressure/cpu", "/proc/pressure/memory", "/proc/pressure/io",
+};
+
+bool Pressure::read(Sample *s)
+{
+	size_t i;
+
+	s->at_ = time::now();
+
+	for (i = 0; i < kResources; i++) {
+		std::string line;
+		std::ifstream f(kFiles[i]);
+
+		// The first line is `some avg10=... avg60=... avg300=... total=N`
+		if (!std::getline(f, line)) {
+			return false;
+		}
+
+		auto total = line.find("total=");
+		if (line.compare(0, 5, "some ") != 0 || total == std::string::npos) {
+			return false;
+		}
+
+		s->stalled_[i] = strtoull(line.c_str() + total + 6, nullptr, 10);
+	}
+
+	return true;
+}
+
+sp<Pressure> Pressure::detect()
+{
+	Sample s;
+
+	if (!read(&s)) {
+		return nullptr;
+	}
+
+	auto p = mksp<Pressure>();
+	p->last_ = s;
+
+	return p;
+}
+
+double Pressure::sample()
+{
+	size_t i;
+	Sample s;
+	double pressure = 0;
+
+	if (!read(&s)) {
+		return 0;
+	}
+
+	auto usec = time::toNanoSeconds(s.at_ - this->last_.at_) / 1000;
+	if (usec == 0) {
+		return 0;
+	}
+
+	for (i = 0; i < kResources; i++) {
+		auto stalled = s.stalled_[i] - this->last_.stalled_[i];
+		pressure = std::max(pressure, (double)stalled / (double)usec);
+	}
+
+	this->last_ = s;
+
+	return std::min(pressure, 1.0);
+}
+
+uint adaptJobs(uint limit, uint min, uint max, double pressure, bool busy)
+{
+	if (pressure > kHighPressure) {
+		limit -= std::max(limit / 4, 1u);
+	} else if (pressure < kLowPressure && busy) {
+		limit++;
+	}
+
+	return std::min(std::max(limit, min), max);
+}
+}
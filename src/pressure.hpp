@@ -0,0 +1,61 @@
+/**
+ * @file
+ * @author Andrew Stone <a@stoney.io>
+ * @copyright 2016 Andrew Stone
+ *
+ * This file is part of paratec and is released under the MIT License:
+ * http://opensource.org/licenses/MIT
+ */
+
+#pragma once
+#include <stdint.h>
+#include <sys/types.h>
+#include "std.hpp"
+#include "time.hpp"
+
+namespace pt
+{
+
+/**
+ * How stalled the system is, from Linux's pressure stall information
+ * (/proc/pressure/)
+ */
+class Pressure
+{
+public:
+	static constexpr size_t kResources = 3;
+
+private:
+	struct Sample {
+		time::point at_;
+
+		/**
+		 * Total microseconds that some tasks were stalled on each resource
+		 */
+		uint64_t stalled_[kResources];
+	};
+
+	Sample last_;
+
+	static bool read(Sample *s);
+
+public:
+	/**
+	 * If pressure stall information is available; otherwise, nullptr
+	 */
+	static sp<Pressure> detect();
+
+	/**
+	 * Fraction of the time since the last sample that some tasks were stalled
+	 * on the most contended of CPU, memory and IO
+	 */
+	double sample();
+};
+
+/**
+ * Decide how many CPUs tests may keep busy next, given the current limit and
+ * the latest pressure. Backs off quickly when the system is stalling, and
+ * creeps back up when it isn't and the tests could use more.
+ */
+uint adaptJobs(uint limit, uint min, uint max, double pressure, bool busy);
+}
@@ -0,0 +1,81 @@
+/**
+ * @author Andrew Stone <a@stoney.io>
+ * @copyright 2016 Andrew Stone
+ *
+ * This file is part of paratec and is released under the MIT License:
+ * http://opensource.org/licenses/MIT
+ */
+
+#include "main.hpp"
+#include "pressure.hpp"
+#include "util_test.hpp"
+
+namespace pt
+{
+
+static struct {
+	uint limit_;
+	double pressure_;
+	bool busy_;
+	uint expect_;
+} _adapt[] = {
+	// Shrink by a quarter, down to the minimum
+	{ 16, 0.9, true, 12 },
+	{ 3, 0.9, true, 2 },
+	{ 2, 0.9, true, 2 },
+
+	// Grow by 1, up to the maximum, but only when it'd be used
+	{ 12, 0.0, true, 13 },
+	{ 12, 0.0, false, 12 },
+	{ 16, 0.0, true, 16 },
+
+	// In between, hold steady
+	{ 12, 0.2, true, 12 },
+};
+
+TESTV(pressureAdapt, _adapt)
+{
+	pt_eq(adaptJobs(_t->limit_, 2, 16, _t->pressure_, _t->busy_),
+		  _t->expect_);
+}
+
+TEST(pressureSample)
+{
+	auto p = Pressure::detect();
+	if (p == nullptr) {
+		pt_skip();
+	}
+
+	usleep(10000);
+
+	auto pressure = p->sample();
+	pt_ge(pressure, 0.0);
+	pt_le(pressure, 1.0);
+}
+
+TEST(_pressure0)
+{
+}
+
+TEST(_pressure1)
+{
+}
+
+TEST(pressureJobsMin)
+{
+	std::stringstream out;
+
+	Main m({ MKTEST(_pressure0), MKTEST(_pressure1) });
+	auto rslts = m.run(out, { "paratec", "-j", "4", "--jobs-min", "1" });
+
+	pt_eq(rslts.exitCode(), 0);
+}
+
+TEST(pressureJobsMinTooMany, PTEXIT(1))
+{
+	std::stringstream out;
+
+	Main m(std::vector<sp<const Test>>{});
+	m.run(out, { "paratec", "-j", "2", "--jobs-min", "3" });
+}
+}
@@ -0,0 +1,337 @@
+/**
+ * @author Andrew Stone <a@stoney.io>
+ * @copyright 2016 Andrew Stone
+ *
+ * This file is part of paratec and is released under the MIT License:
+ * http://opensource.org/licenses/MIT
+ */
+
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <errno.h>
+#include <map>
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include "err.hpp"
+#include "paratec.h"
+#include "profile.hpp"
+#include "util.hpp"
+
+#ifdef PT_LINUX
+#include <ucontext.h>
+#elif defined(PT_DARWIN)
+#include <sys/ucontext.h>
+#endif
+
+namespace pt
+{
+
+/**
+ * There's only ever 1 benchmark running in a process at a time, so there's
+ * only ever 1 profiler, too.
+ */
+static std::atomic<Profiler *> _active{ nullptr };
+
+/**
+ * Where the interrupted code was: its program counter, stack pointer, and
+ * frame pointer. False on machines whose registers aren't known here.
+ */
+static bool _regs(void *uctx, uintptr_t *pc, uintptr_t *sp, uintptr_t *fp)
+{
+	auto uc = (ucontext_t *)uctx;
+
+#if defined(PT_LINUX) && defined(__x86_64__)
+	*pc = (uintptr_t)uc->uc_mcontext.gregs[REG_RIP];
+	*sp = (uintptr_t)uc->uc_mcontext.gregs[REG_RSP];
+	*fp = (uintptr_t)uc->uc_mcontext.gregs[REG_RBP];
+#elif defined(PT_LINUX) && defined(__aarch64__)
+	*pc = (uintptr_t)uc->uc_mcontext.pc;
+	*sp = (uintptr_t)uc->uc_mcontext.sp;
+	*fp = (uintptr_t)uc->uc_mcontext.regs[29];
+#elif defined(PT_DARWIN) && defined(__x86_64__)
+	*pc = (uintptr_t)uc->uc_mcontext->__ss.__rip;
+	*sp = (uintptr_t)uc->uc_mcontext->__ss.__rsp;
+	*fp = (uintptr_t)uc->uc_mcontext->__ss.__rbp;
+#elif defined(PT_DARWIN) && defined(__arm64__)
+	*pc = (uintptr_t)uc->uc_mcontext->__ss.__pc;
+	*sp = (uintptr_t)uc->uc_mcontext->__ss.__sp;
+	*fp = (uintptr_t)uc->uc_mcontext->__ss.__fp;
+#else
+	(void)uc;
+	(void)pc;
+	(void)sp;
+	(void)fp;
+	return false;
+#endif
+
+	return true;
+}
+
+/**
+ * Follow saved frame pointers from fp, collecting return addresses. Every
+ * frame has to sit between sp and hi, further up than the last, so this only
+ * ever reads stack that's in use: unlike backtrace(), it takes no locks and
+ * loads nothing, so it's safe in a signal handler.
+ */
+static int _walk(uintptr_t sp, uintptr_t fp, uintptr_t hi, void **frames,
+				 int max)
+{
+	int depth = 0;
+
+	while (depth < max && fp >= sp && fp % sizeof(uintptr_t) == 0
+		   && fp <= hi - 2 * sizeof(uintptr_t)) {
+		auto frame = (uintptr_t *)fp;
+		if (frame[1] == 0) {
+			break;
+		}
+
+		frames[depth++] = (void *)frame[1];
+		if (frame[0] <= fp) {
+			break;
+		}
+
+		fp = frame[0];
+	}
+
+	return depth;
+}
+
+/**
+ * Bounds of the calling thread's stack
+ */
+static void _stack(uintptr_t *lo, uintptr_t *hi)
+{
+#ifdef PT_LINUX
+	int err;
+	void *addr;
+	size_t size;
+	pthread_attr_t attr;
+
+	err = pthread_getattr_np(pthread_self(), &attr);
+	Err(-err, "failed to get thread attributes: %s", strerror(err));
+
+	DTor d([&]() { pthread_attr_destroy(&attr); });
+
+	err = pthread_attr_getstack(&attr, &addr, &size);
+	Err(-err, "failed to find thread stack: %s", strerror(err));
+
+	*lo = (uintptr_t)addr;
+	*hi = *lo + size;
+#elif defined(PT_DARWIN)
+	auto self = pthread_self();
+
+	*hi = (uintptr_t)pthread_get_stackaddr_np(self);
+	*lo = *hi - pthread_get_stacksize_np(self);
+#endif
+}
+
+static std::string _symbolize(void *addr, bool ret_addr)
+{
+	Dl_info info;
+	char buff[512];
+
+	// Return addresses point just past the call, which can be the start of
+	// the next function.
+	auto lookup = (char *)addr - (ret_addr ? 1 : 0);
+
+	if (dladdr(lookup, &info) == 0) {
+		snprintf(buff, sizeof(buff), "%p", addr);
+		return buff;
+	}
+
+	if (info.dli_sname != nullptr) {
+		int status;
+		std::string sym;
+		char *demangled
+			= abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+
+		if (status == 0) {
+			sym = demangled;
+		} else {
+			sym = info.dli_sname;
+		}
+
+		free(demangled);
+		return sym;
+	}
+
+	const char *obj = strrchr(info.dli_fname, '/');
+	obj = obj == nullptr ? info.dli_fname : obj + 1;
+
+	snprintf(buff, sizeof(buff), "%s+0x%zx", obj,
+			 (size_t)(lookup - (char *)info.dli_fbase));
+	return buff;
+}
+
+void Profiler::handler(int, siginfo_t *, void *uctx)
+{
+	int eno = errno;
+	auto prof = _active.load();
+
+	if (prof != nullptr) {
+		auto i = prof->count_.fetch_add(1);
+		if (i < kMaxSamples) {
+			uintptr_t pc;
+			uintptr_t sp;
+			uintptr_t fp;
+			auto &s = prof->samples_[i];
+
+			// The timer can go off on any thread, but only the benchmark's
+			// stack is known to be safe to walk.
+			s.depth_ = 0;
+			if (_regs(uctx, &pc, &sp, &fp) && sp >= prof->stack_lo_
+				&& sp < prof->stack_hi_) {
+				s.frames_[0] = (void *)pc;
+				s.depth_ = 1
+						   + _walk(sp, fp, prof->stack_hi_, s.frames_ + 1,
+								   kMaxDepth - 1);
+			}
+		} else {
+			prof->dropped_++;
+		}
+	}
+
+	errno = eno;
+}
+
+Profiler::Profiler(std::string dir, std::string root)
+	: root_(std::move(root)), samples_(kMaxSamples)
+{
+	int err;
+	struct sigaction sa;
+
+	err = mkdir(dir.c_str(), 0755);
+	OSErr(err, { EEXIST }, "failed to create profile directory %s",
+		  dir.c_str());
+
+	std::string name(this->root_);
+	for (auto &c : name) {
+		if (c == '/') {
+			c = '_';
+		}
+	}
+
+	this->path_ = dir + "/" + name + ".folded";
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_sigaction = handler;
+	sa.sa_flags = SA_RESTART | SA_SIGINFO;
+	sigemptyset(&sa.sa_mask);
+
+	err = sigaction(SIGPROF, &sa, nullptr);
+	OSErr(err, {}, "failed to install SIGPROF handler");
+}
+
+Profiler::~Profiler()
+{
+	this->stop();
+	signal(SIGPROF, SIG_DFL);
+}
+
+void Profiler::start()
+{
+	int err;
+	struct itimerval it;
+
+	_stack(&this->stack_lo_, &this->stack_hi_);
+
+	// Like a sample, the first frame is where start() is; it's never
+	// compared, so it doesn't matter exactly where.
+	auto fp = (uintptr_t)__builtin_frame_address(0);
+	this->base_.frames_[0] = nullptr;
+	this->base_.depth_ = 1
+						 + _walk(fp, fp, this->stack_hi_,
+								 this->base_.frames_ + 1, kMaxDepth - 1);
+
+	_active.store(this);
+
+	it.it_interval.tv_sec = 0;
+	it.it_interval.tv_usec = kIntervalUsec;
+	it.it_value = it.it_interval;
+
+	err = setitimer(ITIMER_PROF, &it, nullptr);
+	OSErr(err, {}, "failed to start profiling timer");
+}
+
+void Profiler::stop()
+{
+	struct itimerval it;
+
+	memset(&it, 0, sizeof(it));
+	setitimer(ITIMER_PROF, &it, nullptr);
+
+	_active.store(nullptr);
+}
+
+std::string Profiler::fold(const Sample &s) const
+{
+	int i;
+	int end = s.depth_;
+
+	// Everything from Test::bench() up is the same in every sample, so strip
+	// it. base_ was taken from inside start(), so its first frame is start()
+	// and its second is Test::bench().
+	int bi = this->base_.depth_;
+	while (end > 0 && bi > 2
+		   && s.frames_[end - 1] == this->base_.frames_[bi - 1]) {
+		end--;
+		bi--;
+	}
+
+	if (bi < this->base_.depth_) {
+		// And Test::bench() itself
+		end--;
+	}
+
+	if (end <= 0) {
+		return "[paratec]";
+	}
+
+	// The outer-most remaining frame is the benchmark function, which is
+	// static and can't be found by dladdr().
+	std::string stack(this->root_);
+
+	for (i = end - 2; i >= 0; i--) {
+		auto sym = _symbolize(s.frames_[i], i != 0);
+		for (auto &c : sym) {
+			if (c == ';') {
+				c = ':';
+			}
+		}
+
+		stack += ';';
+		stack += sym;
+	}
+
+	return stack;
+}
+
+void Profiler::write() const
+{
+	size_t i;
+	std::map<std::string, uint64_t> stacks;
+	auto count = std::min(this->count_.load(), (size_t)kMaxSamples);
+
+	for (i = 0; i < count; i++) {
+		stacks[this->fold(this->samples_[i])]++;
+	}
+
+	FILE *f = fopen(this->path_.c_str(), "w");
+	OSErr(f == nullptr ? -1 : 0, {}, "failed to open %s",
+		  this->path_.c_str());
+
+	DTor d([&]() { fclose(f); });
+
+	for (const auto &s : stacks) {
+		fprintf(f, "%s %" PRIu64 "\n", s.first.c_str(), s.second);
+	}
+
+	if (this->dropped_ > 0) {
+		fprintf(f, "[dropped] %zu\n", this->dropped_.load());
+	}
+}
+}
@@ -0,0 +1,105 @@
+/**
+ * @file
+ * @author Andrew Stone <a@stoney.io>
+ * @copyright 2016 Andrew Stone
+ *
+ * This file is part of paratec and is released under the MIT License:
+ * http://opensource.org/licenses/MIT
+ */
+
+#pragma once
+#include <atomic>
+#include <signal.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "std.hpp"
+
+namespace pt
+{
+
+/**
+ * A SIGPROF-driven sampling profiler for benchmarks. Samples are only taken
+ * between start() and stop(), so only the timed region of a benchmark shows
+ * up in the output.
+ */
+class Profiler
+{
+public:
+	static constexpr int kMaxDepth = 64;
+	static constexpr size_t kMaxSamples = 8192;
+	static constexpr long kIntervalUsec = 1000;
+
+private:
+	/**
+	 * Where the code was when sampled, then the return address of every
+	 * frame above it
+	 */
+	struct Sample {
+		int depth_;
+		void *frames_[kMaxDepth];
+	};
+
+	/**
+	 * Where the folded stacks go
+	 */
+	std::string path_;
+
+	/**
+	 * Name to give the root frame (the benchmark function)
+	 */
+	std::string root_;
+
+	/**
+	 * Preallocated so that the signal handler never has to allocate
+	 */
+	std::vector<Sample> samples_;
+	std::atomic<size_t> count_{ 0 };
+	std::atomic<size_t> dropped_{ 0 };
+
+	/**
+	 * Stack of the code that called start(); used to strip everything
+	 * above the benchmark function out of the samples.
+	 */
+	Sample base_;
+
+	/**
+	 * Bounds of the stack of the thread running the benchmark. Samples only
+	 * ever follow frames inside of it.
+	 */
+	uintptr_t stack_lo_ = 0;
+	uintptr_t stack_hi_ = 0;
+
+	static void handler(int sig, siginfo_t *info, void *uctx);
+
+	/**
+	 * Turn a sample into a folded stack: root first, frames separated by
+	 * semicolons.
+	 */
+	std::string fold(const Sample &s) const;
+
+public:
+	/**
+	 * Profile the named benchmark, writing its folded stacks into dir.
+	 */
+	Profiler(std::string dir, std::string root);
+	Profiler(const Profiler &) = delete;
+	~Profiler();
+
+	/**
+	 * Start sampling. Must be called from the function that calls the
+	 * benchmark.
+	 */
+	__attribute__((noinline)) void start();
+
+	/**
+	 * Stop sampling
+	 */
+	void stop();
+
+	/**
+	 * Write out all samples taken
+	 */
+	void write() const;
+};
+}
@@ -0,0 +1,104 @@
+/**
+ * @author Andrew Stone <a@stoney.io>
+ * @copyright 2016 Andrew Stone
+ *
+ * This file is part of paratec and is released under the MIT License:
+ * http://opensource.org/licenses/MIT
+ */
+
+#include <fstream>
+#include <sstream>
+#include <stdlib.h>
+#include <sys/time.h>
+#include "main.hpp"
+#include "util.hpp"
+#include "util_test.hpp"
+
+namespace pt
+{
+
+/**
+ * Not static, so that it can be named in the profile
+ */
+void _profiledSum(uint32_t n);
+void _profiledSum(uint32_t n)
+{
+	uint32_t i;
+	volatile uint64_t sum = 0;
+
+	for (i = 0; i < n; i++) {
+		sum += i * i;
+	}
+}
+
+TEST(_profiled, PTBENCH())
+{
+	_profiledSum(_N);
+}
+
+static bool _profilerArmed;
+
+static void _profiledFailCleanup()
+{
+	struct itimerval it;
+
+	getitimer(ITIMER_PROF, &it);
+	_profilerArmed = it.it_value.tv_sec != 0 || it.it_value.tv_usec != 0;
+}
+
+TEST(_profiledFail, PTBENCH(), PTCLEANUP(_profiledFailCleanup))
+{
+	pt_fail("benchmark failed");
+}
+
+TEST(profileBench)
+{
+	std::stringstream out;
+	char dir[] = "/tmp/paratec-profile-XXXXXX";
+
+	pt(mkdtemp(dir) != nullptr);
+
+	std::string arg("--bench-profile=");
+	arg += dir;
+
+	Main m({ MKTEST(_profiled) });
+	m.run(out, { "paratec", "-b", "-d", ".2", arg.c_str() });
+
+	auto path = std::string(dir) + "/_profiled.folded";
+	DTor d([&]() {
+		unlink(path.c_str());
+		rmdir(dir);
+	});
+
+	std::ifstream f(path);
+	pt(f.good(), "profile was not written");
+
+	std::stringstream folded;
+	folded << f.rdbuf();
+
+	auto s = folded.str();
+	pt_in("_profiled;pt::_profiledSum(unsigned int)", s);
+	pt_ni("runBench", s);
+}
+
+TEST(profileNoForkFail)
+{
+	std::stringstream out;
+	char dir[] = "/tmp/paratec-profile-XXXXXX";
+
+	pt(mkdtemp(dir) != nullptr);
+
+	std::string arg("--bench-profile=");
+	arg += dir;
+
+	DTor d([&]() { rmdir(dir); });
+
+	_profilerArmed = true;
+
+	Main m({ MKTEST(_profiledFail) });
+	auto rslts = m.run(out, { "paratec", "-b", "--nofork", arg.c_str() });
+
+	pt_eq(rslts.exitCode(), 1);
+	pt(!_profilerArmed, "profiler still armed after the benchmark failed");
+}
+}
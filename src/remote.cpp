@@ -0,0 +1,223 @@
+/**
+ * @author Andrew Stone <a@stoney.io>
+ * @copyright 2016 Andrew Stone
+ *
+ * This file is part of paratec and is released under the MIT License:
+ * http://opensource.org/licenses/MIT
+ */
+
+#include <errno.h>
+#include <sstream>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "err.hpp"
+#include "fork.hpp"
+#include "leaks.hpp"
+#include "remote.hpp"
+#include "test.hpp"
+
+namespace pt
+{
+
+/**
+ * Characters that mean something in a regex
+ */
+static const char *kRegexSpecial = "\\^$.|?*+()[]{}";
+
+/**
+ * Options that only make sense for the binary driving the others. Left in the
+ * environment, the other binaries would pick them up too. The remote test
+ * already runs in its cgroup, so the limits go with it.
+ */
+static void _scrubEnv(const Opts &opts)
+{
+	const Opt *drivers[] = {
+		&opts.binaries_,	  &opts.cache_,		  &opts.cgroup_,
+		&opts.changed_files_, &opts.count_,		  &opts.cpu_max_,
+		&opts.fail_fast_,	  &opts.failed_first_,  &opts.filter_,
+		&opts.history_,		  &opts.impact_,	  &opts.jobs_min_,
+		&opts.list_,		  &opts.mem_budget_,  &opts.memory_max_,
+		&opts.merge_results_, &opts.output_,	  &opts.pids_max_,
+		&opts.pin_,			  &opts.record_impact_, &opts.rerun_failed_under_,
+		&opts.shard_,		  &opts.until_fail_,
+	};
+
+	for (auto opt : drivers) {
+		unsetenv(opt->env_.c_str());
+	}
+}
+
+/**
+ * Options every run of another binary gets, so that its tests run just like
+ * this binary's would.
+ */
+static std::vector<std::string> _args(const std::string &bin, const Opts &opts)
+{
+	uint i;
+	std::vector<std::string> args{
+		bin, "-t", std::to_string(opts.timeout_.get()),
+	};
+
+	if (opts.bench_.get()) {
+		args.push_back("-b");
+		args.push_back("-d");
+		args.push_back(std::to_string(opts.bench_dur_.get()));
+	}
+
+	if (opts.cov_lock_.get()) {
+		args.push_back("--cov-lock");
+	}
+
+	if (opts.leaks_.get()) {
+		args.push_back("--leaks");
+	}
+
+	for (i = 0; i < opts.verbose_.get(); i++) {
+		args.push_back("-v");
+	}
+
+	return args;
+}
+
+[[noreturn]] static void _exec(const std::vector<std::string> &args,
+							   bool search = false)
+{
+	std::vector<char *> argv;
+
+	for (const auto &a : args) {
+		argv.push_back(const_cast<char *>(a.c_str()));
+	}
+
+	argv.push_back(nullptr);
+
+	// Binaries are paths; commands to run them under come from the PATH
+	if (search) {
+		execvp(argv[0], argv.data());
+	} else {
+		execv(argv[0], argv.data());
+	}
+
+	fprintf(stderr, "failed to exec %s: %s\n", argv[0], strerror(errno));
+	_exit(127);
+}
+
+void Remote::exec(const Opts &opts,
+				  const std::vector<std::string> &under) const
+{
+	std::string re("/");
+	for (auto c : this->name_) {
+		if (strchr(kRegexSpecial, c) != nullptr) {
+			re += '\\';
+		}
+		re += c;
+	}
+	re += '/';
+
+	auto args = _args(this->bin_, opts);
+	args.insert(args.end(), { "-f", re, "-j", "1" });
+
+	if (this->out_.size() > 0) {
+		args.insert(args.end(), { "-o", this->out_ });
+	}
+
+	if (under.size() > 0) {
+		std::vector<std::string> cmd;
+
+		for (const auto &arg : under) {
+			cmd.push_back(arg == "{}" ? this->bin_ : arg);
+		}
+
+		cmd.insert(cmd.end(), args.begin() + 1, args.end());
+		args = std::move(cmd);
+	}
+
+	if (opts.leaks_.get()) {
+		leaks::inject();
+	}
+
+	_scrubEnv(opts);
+	_exec(args, under.size() > 0);
+}
+
+Remotes::Remotes()
+{
+	char dir[] = "/tmp/paratec-remote-XXXXXX";
+
+	if (mkdtemp(dir) == nullptr) {
+		OSErr(-1, {}, "failed to create directory for remote results");
+	}
+
+	this->dir_ = dir;
+}
+
+Remotes::~Remotes()
+{
+	for (const auto &out : this->outs_) {
+		unlink(out.c_str());
+	}
+
+	rmdir(this->dir_.c_str());
+}
+
+sp<Remote> Remotes::make(const std::string &bin, const std::string &name)
+{
+	auto r = mksp<Remote>();
+	r->bin_ = bin;
+	r->name_ = name;
+	r->out_ = this->dir_ + "/" + std::to_string(this->outs_.size());
+	this->outs_.push_back(r->out_);
+
+	return r;
+}
+
+std::vector<sp<const Test>> Remotes::list(const std::string &bin,
+										  const Opts &opts)
+{
+	Fork f;
+	std::string line;
+	std::vector<sp<const Test>> tests;
+
+	auto e = f.run([&]() {
+		auto args = _args(bin, opts);
+		args.push_back("--list");
+
+		_scrubEnv(opts);
+		_exec(args);
+	});
+
+	if (e.status_ != 0 || e.signal_ != 0) {
+		Err(-1, "failed to list tests in %s: %s", bin.c_str(),
+			e.stderr_.c_str());
+	}
+
+	auto slash = bin.rfind('/');
+	auto prefix = (slash == std::string::npos ? bin : bin.substr(slash + 1))
+				  + "/";
+
+	// Otherwise, 2 binaries' tests could be told apart by nothing
+	auto added = this->prefixes_.emplace(prefix, bin);
+	if (!added.second) {
+		Err(-1, "%s and %s would both name their tests %s*; rename one",
+			added.first->second.c_str(), bin.c_str(), prefix.c_str());
+	}
+
+	std::istringstream is(e.stdout_);
+	while (std::getline(is, line)) {
+		auto tab = line.find('\t');
+		if (tab == std::string::npos) {
+			Err(-1, "%s: invalid test listing: %s", bin.c_str(),
+				line.c_str());
+		}
+
+		auto r = this->make(bin, line.substr(0, tab));
+
+		// Give the binary a second to start up and write its results
+		auto timeout = atof(line.c_str() + tab + 1) + 1.0;
+
+		tests.push_back(mksp<Test>(prefix + r->name_, std::move(r), timeout));
+	}
+
+	return tests;
+}
+}
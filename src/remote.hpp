@@ -0,0 +1,82 @@
+/**
+ * @file
+ * @author Andrew Stone <a@stoney.io>
+ * @copyright 2016 Andrew Stone
+ *
+ * This file is part of paratec and is released under the MIT License:
+ * http://opensource.org/licenses/MIT
+ */
+
+#pragma once
+#include <map>
+#include <string>
+#include <vector>
+#include "opts.hpp"
+#include "std.hpp"
+
+namespace pt
+{
+
+class Test;
+
+/**
+ * A test that lives in another paratec binary
+ */
+struct Remote {
+	/**
+	 * Path to the binary
+	 */
+	std::string bin_;
+
+	/**
+	 * Name of the test in that binary
+	 */
+	std::string name_;
+
+	/**
+	 * Where the binary writes the test's results. Without one, the results
+	 * are only printed.
+	 */
+	std::string out_;
+
+	/**
+	 * Replace this process with the binary, running only this test. With a
+	 * command to run under, the command is run instead, with every `{}` in
+	 * it replaced by the binary. Only ever called from a forked process.
+	 */
+	[[noreturn]] void
+	exec(const Opts &opts, const std::vector<std::string> &under = {}) const;
+};
+
+/**
+ * Finds the tests in other paratec binaries, and keeps the directory their
+ * results are written to for as long as it lives.
+ */
+class Remotes
+{
+	std::string dir_;
+	std::vector<std::string> outs_;
+
+	/**
+	 * The binary each prefix given to tests belongs to
+	 */
+	std::map<std::string, std::string> prefixes_;
+
+public:
+	Remotes();
+	Remotes(const Remotes &) = delete;
+	~Remotes();
+
+	/**
+	 * A test in the binary, with somewhere for its results to go
+	 */
+	sp<Remote> make(const std::string &bin, const std::string &name);
+
+	/**
+	 * Ask the binary for all of its tests, as tests that run it. Tests are
+	 * named after the binary's file name, which no other binary may share.
+	 */
+	std::vector<sp<const Test>> list(const std::string &bin,
+									 const Opts &opts);
+};
+}
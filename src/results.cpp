@@ -7,11 +7,20 @@
  */
 
 #include <algorithm>
+#include <atomic>
+#include <fstream>
 #include <inttypes.h>
+#include <limits.h>
+#include <map>
 #include <sstream>
 #include <string.h>
 #include <string>
+#include <thread>
+#include <unistd.h>
+#include "cache.hpp"
+#include "fork.hpp"
 #include "results.hpp"
+#include "stats.hpp"
 #include "util.hpp"
 
 namespace pt
@@ -19,11 +28,123 @@ namespace pt
 
 #define STDPREFIX INDENT INDENT INDENT " | "
 
+/**
+ * First line of every results file
+ */
+static const char *kResultsHeader = "paratec-results-v1";
+
+/**
+ * Results files are made of lines of tab-separated `key=value` pairs, so
+ * values can't contain tabs or newlines. Items of a list are separated by
+ * commas, so they can't contain those, either.
+ */
+static void _escape(std::ostream &os, const std::string &s, bool item = false)
+{
+	for (auto c : s) {
+		switch (c) {
+		case '\\':
+			os << "\\\\";
+			break;
+
+		case ',':
+			// Separates the items of a list
+			os << (item ? "\\," : ",");
+			break;
+
+		case '\t':
+			os << "\\t";
+			break;
+
+		case '\n':
+			os << "\\n";
+			break;
+
+		default:
+			os << c;
+			break;
+		}
+	}
+}
+
+static std::string _unescape(const std::string &s)
+{
+	size_t i;
+	std::string out;
+
+	for (i = 0; i < s.size(); i++) {
+		if (s[i] != '\\' || i + 1 == s.size()) {
+			out += s[i];
+			continue;
+		}
+
+		switch (s[++i]) {
+		case 't':
+			out += '\t';
+			break;
+
+		case 'n':
+			out += '\n';
+			break;
+
+		default:
+			out += s[i];
+			break;
+		}
+	}
+
+	return out;
+}
+
+/**
+ * Split a list written by Result::write() into its unescaped items
+ */
+static std::vector<std::string> _split(const std::string &s)
+{
+	size_t i;
+	std::vector<std::string> items(1);
+
+	for (i = 0; i < s.size(); i++) {
+		if (s[i] == ',') {
+			items.emplace_back();
+			continue;
+		}
+
+		if (s[i] == '\\' && i + 1 < s.size()) {
+			items.back() += s[i++];
+		}
+
+		items.back() += s[i];
+	}
+
+	for (auto &item : items) {
+		item = _unescape(item);
+	}
+
+	return items;
+}
+
 void Result::reset(sp<const Test> test)
 {
 	*this = Result();
 	this->test_ = std::move(test);
 	this->start_ = time::now();
+
+	this->name_ = this->test_->name();
+	this->test_name_ = this->test_->name();
+	this->enabled_ = this->test_->enabled();
+	this->bench_ = this->test_->isBenchmark();
+	this->expect_signal_ = this->test_->signal_num_;
+	this->expect_exit_ = this->test_->exit_status_;
+}
+
+void Result::replaceWith(Result r)
+{
+	auto test = std::move(this->test_);
+	auto start = this->start_;
+
+	*this = std::move(r);
+	this->test_ = std::move(test);
+	this->start_ = start;
 }
 
 void Result::dumpOuts(std::ostream &os, bool print) const
@@ -34,8 +155,10 @@ void Result::dumpOuts(std::ostream &os, bool print) const
 
 	this->dumpOut(os, "stdout", this->stdout_);
 	this->dumpOut(os, "stderr", this->stderr_);
+	this->dumpOut(os, "rerun", this->rerun_);
 
-	if (this->stdout_.size() > 0 || this->stderr_.size() > 0) {
+	if (this->stdout_.size() > 0 || this->stderr_.size() > 0
+		|| this->rerun_.size() > 0) {
 		format(os, "\n");
 	}
 }
@@ -59,6 +182,36 @@ void Result::dumpOut(std::ostream &os,
 	}
 }
 
+void Result::dumpVariants(std::ostream &os) const
+{
+	if (this->bench_variants_.size() == 0) {
+		return;
+	}
+
+	const auto &base = this->bench_variants_[0];
+
+	format(os, INDENT INDENT INDENT "%'" PRIu64 " interleaved rounds\n",
+		   this->bench_rounds_);
+	format(os, INDENT INDENT INDENT "%s: %'.1f ns/op (baseline)\n",
+		   base.name_.c_str(), base.ns_op_);
+
+	for (auto it = this->bench_variants_.begin() + 1;
+		 it != this->bench_variants_.end(); it++) {
+		format(os,
+			   INDENT INDENT INDENT "%s: %'.1f ns/op, %.3fx ±%.3f vs %s\n",
+			   it->name_.c_str(), it->ns_op_, it->speedup_, it->ci_,
+			   base.name_.c_str());
+	}
+}
+
+void Result::dumpTiers(std::ostream &os) const
+{
+	for (const auto &t : this->bench_tiers_) {
+		format(os, INDENT INDENT INDENT "%-4s (%s): %'" PRIu64 " ns/op\n",
+			   t.name_.c_str(), humanBytes(t.wss_).c_str(), t.ns_op_);
+	}
+}
+
 void Result::finalize(const TestEnv &te, sp<const Opts> opts)
 {
 	const auto &v = opts->verbose_;
@@ -66,6 +219,28 @@ void Result::finalize(const TestEnv &te, sp<const Opts> opts)
 	this->name_ = te.test_name_;
 	this->bench_iters_ = te.bench_iters_;
 	this->bench_ns_op_ = te.bench_ns_op_;
+	this->bench_rounds_ = te.bench_rounds_;
+	this->bench_layouts_ = te.bench_layouts_;
+	this->bench_layout_sd_ = te.bench_layout_sd_;
+
+	if (this->bench_rounds_ > 0) {
+		size_t i;
+		const auto &vars = this->test_->variants();
+
+		for (i = 0; i < vars.size(); i++) {
+			this->bench_variants_.push_back({
+				vars[i], te.bench_var_ns_op_[i], te.bench_var_speedup_[i],
+				te.bench_var_ci_[i],
+			});
+		}
+	}
+
+	for (uint64_t i = 0; i < te.bench_tiers_; i++) {
+		this->bench_tiers_.push_back({
+			te.bench_tier_name_[i], te.bench_tier_wss_[i],
+			te.bench_tier_ns_op_[i],
+		});
+	}
 
 	if (this->test_->isRanged() && *te.iter_name_ != '\0') {
 		this->name_ += ':';
@@ -86,8 +261,7 @@ void Result::finalize(const TestEnv &te, sp<const Opts> opts)
 		this->error_ = this->test_->exit_status_ != this->exit_status_;
 	}
 
-	auto passed = this->skipped_
-				  || (!this->failed_ && !this->error_ && !this->timedout_);
+	auto passed = this->passed();
 	if (passed && !v.passedOutput()) {
 		this->stdout_.clear();
 		this->stderr_.clear();
@@ -105,6 +279,53 @@ void Result::finalize(const TestEnv &te, sp<const Opts> opts)
 			this->last_line_ = te.last_test_mark_;
 		}
 	}
+
+	if (this->test_->remote() != nullptr) {
+		this->loadRemote(*this->test_->remote());
+	}
+}
+
+void Result::loadRemote(const Remote &remote)
+{
+	// Without a results file, the binary died before it could say anything
+	// about the test, so the exit status and output are all there is.
+	if (access(remote.out_.c_str(), F_OK) != 0) {
+		return;
+	}
+
+	auto rs = Results::load(remote.out_);
+	unlink(remote.out_.c_str());
+
+	auto prefix
+		= this->test_name_.substr(0, this->test_name_.size() - remote.name_.size());
+
+	for (auto &r : rs) {
+		if (r.test_name_ != remote.name_ || !r.enabled()) {
+			continue;
+		}
+
+		// The binary's idea of how long the test took doesn't include
+		// starting the binary, which this run paid for. The same goes for
+		// everything else measured from out here.
+		auto duration = this->duration_;
+		auto memory_peak = this->memory_peak_;
+		auto cpu_usec = this->cpu_usec_;
+		auto max_rss = this->max_rss_;
+
+		this->replaceWith(std::move(r));
+		this->duration_ = duration;
+		this->memory_peak_ = memory_peak;
+		this->cpu_usec_ = cpu_usec;
+		this->max_rss_ = max_rss;
+		this->name_ = prefix + this->name_;
+		this->test_name_ = prefix + this->test_name_;
+
+		return;
+	}
+
+	this->error_ = false;
+	this->failed_ = true;
+	this->fail_msg_ = remote.bin_ + " did not run the test";
 }
 
 void Result::dump(std::ostream &os, sp<const Opts> opts) const
@@ -118,6 +339,13 @@ void Result::dump(std::ostream &os, sp<const Opts> opts) const
 		return;
 	}
 
+	if (this->notrun_) {
+		if (v.allStatuses()) {
+			format(os, INDENT " NOT RUN : %s \n", this->name_.c_str());
+		}
+		return;
+	}
+
 	if (this->skipped_) {
 		if (v.allStatuses()) {
 			format(os, INDENT "    SKIP : %s \n", this->name_.c_str());
@@ -130,14 +358,13 @@ void Result::dump(std::ostream &os, sp<const Opts> opts) const
 		format(os, INDENT "   ERROR : %s (%fs) : after %s : ",
 			   this->name_.c_str(), this->duration_, this->last_line_.c_str());
 
-		if (this->signal_num_ != 0 || this->test_->signal_num_ != 0) {
+		if (this->signal_num_ != 0 || this->expect_signal_ != 0) {
 			format(os, "received signal (%d) `%s`, expected (%d) `%s`\n",
 				   this->signal_num_, strsignal(this->signal_num_),
-				   this->test_->signal_num_,
-				   strsignal(this->test_->signal_num_));
+				   this->expect_signal_, strsignal(this->expect_signal_));
 		} else {
 			format(os, "got exit code=%d, expected %d\n", this->exit_status_,
-				   this->test_->exit_status_);
+				   this->expect_exit_);
 		}
 
 		this->dumpOuts(os, true);
@@ -159,23 +386,225 @@ void Result::dump(std::ostream &os, sp<const Opts> opts) const
 		return;
 	}
 
-	if (this->test_->bench_) {
+	if (this->bench_) {
 		format(os, INDENT "   BENCH : %s (%'" PRIu64 " @ %'" PRIu64 " ns/op)\n",
 			   this->name_.c_str(), this->bench_iters_, this->bench_ns_op_);
+		if (this->bench_layouts_ > 0) {
+			format(os,
+				   INDENT INDENT INDENT "%'" PRIu64
+										" layouts, ±%'.1f ns/op stddev\n",
+				   this->bench_layouts_, this->bench_layout_sd_);
+		}
+
+		this->dumpVariants(os);
+		this->dumpTiers(os);
 		this->dumpOuts(os, v.passedOutput());
 		return;
 	}
 
 	if (v.passedStatuses()) {
-		format(os, INDENT "    PASS : %s (%fs) \n", this->name_.c_str(),
-			   this->duration_);
+		if (this->cached_) {
+			format(os, INDENT "    PASS : %s (cached) \n", this->name_.c_str());
+		} else {
+			format(os, INDENT "    PASS : %s (%fs) \n", this->name_.c_str(),
+				   this->duration_);
+		}
 	}
 	this->dumpOuts(os, v.passedOutput());
 }
 
+void Result::write(std::ostream &os) const
+{
+	auto str = [&](const char *key, const std::string &v) {
+		os << key << '=';
+		_escape(os, v);
+		os << '\t';
+	};
+
+	auto num = [&](const char *key, double v) {
+		format(os, "%s=%.17g\t", key, v);
+	};
+
+	auto list = [&](const char *key, const std::vector<std::string> &items) {
+		size_t i;
+
+		os << key << '=';
+		for (i = 0; i < items.size(); i++) {
+			if (i > 0) {
+				os << ',';
+			}
+
+			_escape(os, items[i], true);
+		}
+		os << '\t';
+	};
+
+	auto numstr = [](double v) {
+		char buff[32];
+		snprintf(buff, sizeof(buff), "%.17g", v);
+		return std::string(buff);
+	};
+
+	str("name", this->name_);
+	str("test", this->test_name_);
+	num("enabled", this->enabled_);
+	num("bench", this->bench_);
+	num("error", this->error_);
+	num("failed", this->failed_);
+	num("skipped", this->skipped_);
+	num("cached", this->cached_);
+	num("notrun", this->notrun_);
+	num("timedout", this->timedout_);
+	num("exit_status", this->exit_status_);
+	num("signal_num", this->signal_num_);
+	num("expect_exit", this->expect_exit_);
+	num("expect_signal", this->expect_signal_);
+	num("duration", this->duration_);
+	num("memory_peak", (double)this->memory_peak_);
+	num("cpu_usec", (double)this->cpu_usec_);
+	num("max_rss", (double)this->max_rss_);
+	num("bench_iters", (double)this->bench_iters_);
+	num("bench_ns_op", (double)this->bench_ns_op_);
+	num("bench_rounds", (double)this->bench_rounds_);
+	num("bench_layouts", (double)this->bench_layouts_);
+	num("bench_layout_sd", this->bench_layout_sd_);
+
+	// One field per variant and tier, in order
+	for (const auto &v : this->bench_variants_) {
+		list("bench_variant", { v.name_, numstr(v.ns_op_),
+								numstr(v.speedup_), numstr(v.ci_) });
+	}
+
+	for (const auto &t : this->bench_tiers_) {
+		list("bench_tier", { t.name_, numstr((double)t.wss_),
+							 numstr((double)t.ns_op_) });
+	}
+
+	str("last_line", this->last_line_);
+	str("fail_msg", this->fail_msg_);
+	str("stdout", this->stdout_);
+	str("stderr", this->stderr_);
+	str("rerun", this->rerun_);
+
+	os << '\n';
+}
+
+Result Result::read(const std::string &line)
+{
+	Result r;
+	size_t start = 0;
+
+	while (start < line.size()) {
+		auto end = line.find('\t', start);
+		if (end == std::string::npos) {
+			end = line.size();
+		}
+
+		auto eq = line.find('=', start);
+		if (eq == std::string::npos || eq > end) {
+			Err(-1, "invalid result field: %s",
+				line.substr(start, end - start).c_str());
+		}
+
+		auto key = line.substr(start, eq - start);
+		auto raw = line.substr(eq + 1, end - eq - 1);
+		auto val = _unescape(raw);
+		auto num = atof(val.c_str());
+
+		if (key == "name") {
+			r.name_ = std::move(val);
+		} else if (key == "test") {
+			r.test_name_ = std::move(val);
+		} else if (key == "enabled") {
+			r.enabled_ = num != 0;
+		} else if (key == "bench") {
+			r.bench_ = num != 0;
+		} else if (key == "error") {
+			r.error_ = num != 0;
+		} else if (key == "failed") {
+			r.failed_ = num != 0;
+		} else if (key == "skipped") {
+			r.skipped_ = num != 0;
+		} else if (key == "cached") {
+			r.cached_ = num != 0;
+		} else if (key == "notrun") {
+			r.notrun_ = num != 0;
+		} else if (key == "timedout") {
+			r.timedout_ = num != 0;
+		} else if (key == "exit_status") {
+			r.exit_status_ = (int)num;
+		} else if (key == "signal_num") {
+			r.signal_num_ = (int)num;
+		} else if (key == "expect_exit") {
+			r.expect_exit_ = (int)num;
+		} else if (key == "expect_signal") {
+			r.expect_signal_ = (int)num;
+		} else if (key == "duration") {
+			r.duration_ = num;
+		} else if (key == "memory_peak") {
+			r.memory_peak_ = (uint64_t)num;
+		} else if (key == "cpu_usec") {
+			r.cpu_usec_ = (uint64_t)num;
+		} else if (key == "max_rss") {
+			r.max_rss_ = (uint64_t)num;
+		} else if (key == "bench_iters") {
+			r.bench_iters_ = (uint64_t)num;
+		} else if (key == "bench_ns_op") {
+			r.bench_ns_op_ = (uint64_t)num;
+		} else if (key == "bench_rounds") {
+			r.bench_rounds_ = (uint64_t)num;
+		} else if (key == "bench_layouts") {
+			r.bench_layouts_ = (uint64_t)num;
+		} else if (key == "bench_layout_sd") {
+			r.bench_layout_sd_ = num;
+		} else if (key == "bench_variant") {
+			auto items = _split(raw);
+			if (items.size() != 4) {
+				Err(-1, "invalid benchmark variant: %s", val.c_str());
+			}
+
+			r.bench_variants_.push_back({
+				items[0], atof(items[1].c_str()), atof(items[2].c_str()),
+				atof(items[3].c_str()),
+			});
+		} else if (key == "bench_tier") {
+			auto items = _split(raw);
+			if (items.size() != 3) {
+				Err(-1, "invalid benchmark tier: %s", val.c_str());
+			}
+
+			r.bench_tiers_.push_back({
+				items[0], (uint64_t)atof(items[1].c_str()),
+				(uint64_t)atof(items[2].c_str()),
+			});
+		} else if (key == "last_line") {
+			r.last_line_ = std::move(val);
+		} else if (key == "fail_msg") {
+			r.fail_msg_ = std::move(val);
+		} else if (key == "stdout") {
+			r.stdout_ = std::move(val);
+		} else if (key == "stderr") {
+			r.stderr_ = std::move(val);
+		} else if (key == "rerun") {
+			r.rerun_ = std::move(val);
+		}
+
+		// Anything else is from a newer version; ignore it
+
+		start = end + 1;
+	}
+
+	return r;
+}
+
 void Results::startTimer()
 {
 	this->start_ = time::now();
+
+	// With nothing to run, nothing finishes to stop it
+	if (this->done()) {
+		this->end_ = this->start_;
+	}
 }
 
 void Results::inc(bool enabled)
@@ -186,17 +615,22 @@ void Results::inc(bool enabled)
 	}
 }
 
-void Results::record(const TestEnv &ti, Result r)
+char Results::tally(Result r)
 {
 	char summary = '\0';
 
-	r.finalize(ti, this->opts_);
-
 	this->finished_++;
-	this->tests_duration_ += r.duration_;
+
+	// Cached tests didn't use any time in this run
+	if (!r.cached_) {
+		this->tests_duration_ += r.duration_;
+	}
 
 	if (!r.enabled()) {
 		// Skip all tallying
+	} else if (r.notrun_) {
+		this->enabled_--;
+		this->notrun_++;
 	} else if (r.skipped_) {
 		summary = 'S';
 		this->enabled_--;
@@ -217,10 +651,160 @@ void Results::record(const TestEnv &ti, Result r)
 	} else {
 		summary = '.';
 		this->passes_++;
+		this->cached_ += r.cached_;
 	}
 
 	this->results_.push_back(std::move(r));
 
+	return summary;
+}
+
+Results::Results(sp<Opts> opts, std::ostream &os)
+	: opts_(std::move(opts)), os_(os)
+{
+	const auto &dir = this->opts_->cache_.get();
+
+	if (dir.size() > 0) {
+		this->cache_ = mksp<Cache>(dir, *this->opts_);
+	}
+
+	const auto &failed = this->opts_->failed_first_.get();
+	if (failed.size() > 0) {
+		std::string name;
+		std::ifstream f(failed);
+
+		// Nothing has failed before the first run
+		while (std::getline(f, name)) {
+			if (name.size() > 0) {
+				this->failed_last_.insert(std::move(name));
+			}
+		}
+	}
+}
+
+void Results::rerunFailed()
+{
+	const auto &cmd = this->opts_->rerun_failed_under_.cmd();
+	std::vector<Result *> failed;
+
+	for (auto &r : this->results_) {
+		if (r.enabled() && !r.passed() && r.test() != nullptr) {
+			failed.push_back(&r);
+		}
+	}
+
+	if (failed.size() == 0) {
+		return;
+	}
+
+	// argv[0] might have come from the PATH. Valgrind rewrites /proc/self/exe
+	// to be the binary it runs, so even under it, this is the test binary.
+	char exe[PATH_MAX];
+	auto len = readlink("/proc/self/exe", exe, sizeof(exe) - 1);
+	OSErr(len, {}, "failed to find the test binary");
+	exe[len] = '\0';
+
+	std::atomic<size_t> next{ 0 };
+	auto rerun = [&]() {
+		size_t i;
+
+		while ((i = next++) < failed.size()) {
+			auto r = failed[i];
+			auto remote = r->test()->remote();
+
+			Remote local;
+			if (remote == nullptr) {
+				local.bin_ = exe;
+				local.name_ = r->test()->name();
+				remote = &local;
+			}
+
+			Fork f;
+			auto e = f.run([&]() { remote->exec(*this->opts_, cmd); });
+
+			r->rerun_ = e.stdout_ + e.stderr_;
+			if (e.signal_ != 0) {
+				r->rerun_ += "received signal " + std::to_string(e.signal_);
+			} else {
+				r->rerun_ += "exited with " + std::to_string(e.status_);
+			}
+		}
+	};
+
+	// Whatever a test runs under tends to be slow, so run as many as tests
+	// ran at once.
+	std::vector<std::thread> ths;
+	auto nths = std::min((size_t)this->opts_->jobs_.get(), failed.size());
+	while (ths.size() < nths) {
+		ths.emplace_back(rerun);
+	}
+
+	for (auto &th : ths) {
+		th.join();
+	}
+}
+
+bool Results::fromCache(const Test &test, Result *r) const
+{
+	return this->cache_ != nullptr && this->cache_->get(test, r);
+}
+
+void Results::record(const TestEnv &ti, Result r)
+{
+	// Cached results were finalized when they were first recorded
+	if (!r.cached_) {
+		r.finalize(ti, this->opts_);
+
+		if (this->cache_ != nullptr) {
+			this->cache_->put(*r.test(), r);
+		}
+	}
+
+	if (!r.passed() && r.test()->fail_fast_) {
+		this->abandoned_.insert(r.test()->funcName());
+	}
+
+	this->progress(this->tally(std::move(r)));
+}
+
+void Results::cancel(sp<const Test> test)
+{
+	Result r;
+
+	r.reset(std::move(test));
+	r.notrun_ = r.enabled();
+
+	this->progress(this->tally(std::move(r)));
+}
+
+bool Results::failingFast() const
+{
+	auto n = this->opts_->fail_fast_.get();
+	return n > 0 && this->errors_ + this->failures_ >= n;
+}
+
+bool Results::abandoned(const Test &test) const
+{
+	return test.fail_fast_ && this->abandoned_.count(test.funcName()) > 0;
+}
+
+bool Results::repeat(size_t rounds) const
+{
+	const auto count = this->opts_->count_.get();
+
+	if (this->failingFast()) {
+		return false;
+	}
+
+	if (count > 0) {
+		return rounds < count;
+	}
+
+	return this->opts_->until_fail_.get();
+}
+
+void Results::progress(char summary)
+{
 	if (this->opts_->fork_ && this->opts_->capture_) {
 		if (summary != '\0') {
 			format(this->os_, "%c", summary);
@@ -257,16 +841,168 @@ void Results::dump()
 							   : (int)((((double)this->passes_)
 										/ ((double)this->enabled_)) * 100));
 	format(this->os_, "of %zu tests run, ", this->enabled_);
-	format(this->os_, "%zu OK, ", this->passes_);
+	format(this->os_, "%zu OK", this->passes_);
+	if (this->cached_ > 0) {
+		format(this->os_, " (%zu cached)", this->cached_);
+	}
+	format(this->os_, ", ");
 	format(this->os_, "%zu errors, ", this->errors_);
 	format(this->os_, "%zu failures, ", this->failures_);
-	format(this->os_, "%zu skipped. ", this->skipped_);
+	format(this->os_, "%zu skipped", this->skipped_);
+	if (this->notrun_ > 0) {
+		format(this->os_, ", %zu not run", this->notrun_);
+	}
+	format(this->os_, ". ");
 	format(this->os_, "Ran %zu benches. ", this->benches_);
 	format(this->os_, "Took %fs (tests used %fs)\n",
-		   time::toSeconds(this->end_ - this->start_), this->tests_duration_);
+		   this->merged_ ? this->merged_wall_
+						 : time::toSeconds(this->end_ - this->start_),
+		   this->tests_duration_);
 
 	for (const auto &r : this->results_) {
 		r.dump(this->os_, this->opts_);
 	}
+
+	this->dumpRepeats();
+}
+
+void Results::dumpRepeats() const
+{
+	struct Runs {
+		size_t failed_ = 0;
+		std::vector<double> durs_;
+	};
+
+	std::map<std::string, Runs> runs;
+	for (const auto &r : this->results_) {
+		if (r.enabled() && !r.notrun_ && !r.skipped_) {
+			auto &run = runs[r.test_name_];
+			run.failed_ += !r.passed();
+			run.durs_.push_back(r.duration_);
+		}
+	}
+
+	for (const auto &it : runs) {
+		const auto &run = it.second;
+		if (run.durs_.size() < 2
+			|| (run.failed_ == 0 && !this->opts_->verbose_.passedStatuses())) {
+			continue;
+		}
+
+		format(this->os_,
+			   INDENT "  REPEAT : %s : %zu of %zu failed : %fs min, %fs p50, "
+					  "%fs p90, %fs max\n",
+			   it.first.c_str(), run.failed_, run.durs_.size(),
+			   stats::percentile(run.durs_, 0), stats::percentile(run.durs_, 50),
+			   stats::percentile(run.durs_, 90),
+			   stats::percentile(run.durs_, 100));
+	}
+}
+
+void Results::write(const std::string &path) const
+{
+	Results::save(path, this->results_,
+				  this->merged_ ? this->merged_wall_
+								: time::toSeconds(this->end_ - this->start_));
+}
+
+void Results::writeFailed(const std::string &path) const
+{
+	auto failed = this->failed_last_;
+	std::set<std::string> failing;
+
+	// Tests that didn't run this time (filtered out, or stopped by
+	// --fail-fast) are as broken as they were. With --count, a test that
+	// failed any of its runs is still failing.
+	for (const auto &r : this->results_) {
+		if (!r.enabled() || r.notrun_) {
+			continue;
+		}
+
+		if (r.passed()) {
+			failed.erase(r.test_name_);
+		} else {
+			failing.insert(r.test_name_);
+		}
+	}
+
+	failed.insert(failing.begin(), failing.end());
+
+	std::ofstream f(path, std::ios::trunc);
+	if (!f.good()) {
+		OSErr(-1, {}, "failed to open %s", path.c_str());
+	}
+
+	for (const auto &name : failed) {
+		f << name << '\n';
+	}
+
+	f.flush();
+	if (!f.good()) {
+		OSErr(-1, {}, "failed to write %s", path.c_str());
+	}
+}
+
+void Results::save(const std::string &path,
+				   const std::vector<Result> &rs,
+				   double wall)
+{
+	std::ofstream f(path, std::ios::trunc);
+	if (!f.good()) {
+		OSErr(-1, {}, "failed to open results file %s", path.c_str());
+	}
+
+	format(f, "%s\twall=%f\n", kResultsHeader, wall);
+
+	for (const auto &r : rs) {
+		r.write(f);
+	}
+
+	f.flush();
+	if (!f.good()) {
+		OSErr(-1, {}, "failed to write results file %s", path.c_str());
+	}
+}
+
+std::vector<Result> Results::load(const std::string &path, double *wall)
+{
+	std::string line;
+	std::vector<Result> rs;
+	std::ifstream f(path);
+
+	if (!f.good()) {
+		OSErr(-1, {}, "failed to open results file %s", path.c_str());
+	}
+
+	if (!std::getline(f, line) || line.find(kResultsHeader) != 0) {
+		Err(-1, "%s is not a paratec results file", path.c_str());
+	}
+
+	auto w = line.find("\twall=");
+	if (wall != nullptr && w != std::string::npos) {
+		*wall = atof(line.c_str() + w + 6);
+	}
+
+	while (std::getline(f, line)) {
+		if (line.size() > 0) {
+			rs.push_back(Result::read(line));
+		}
+	}
+
+	return rs;
+}
+
+void Results::merge(const std::string &path)
+{
+	double wall = 0.0;
+	auto rs = Results::load(path, &wall);
+
+	this->merged_ = true;
+	this->merged_wall_ = std::max(this->merged_wall_, wall);
+
+	for (auto &r : rs) {
+		this->inc(r.enabled());
+		this->tally(std::move(r));
+	}
 }
 }
@@ -8,6 +8,7 @@
  */
 
 #pragma once
+#include <set>
 #include <string>
 #include <vector>
 #include "opts.hpp"
@@ -19,6 +20,8 @@
 namespace pt
 {
 
+class Cache;
+
 /**
  * Result of a single test run
  */
@@ -28,16 +31,62 @@ class Result
 	time::point start_;
 
 	void dumpOuts(std::ostream &os, bool print) const;
+	void dumpVariants(std::ostream &os) const;
+	void dumpTiers(std::ostream &os) const;
 	void
 	dumpOut(std::ostream &os, const char *which, const std::string &s) const;
 
+	/**
+	 * Take the result written by the binary a remote test ran in
+	 */
+	void loadRemote(const Remote &remote);
+
 public:
+	/**
+	 * A variant compared by a PTCMP benchmark
+	 */
+	struct Variant {
+		std::string name_;
+		double ns_op_;
+
+		/**
+		 * Speedup relative to the baseline, with the half-width of its 95%
+		 * confidence interval.
+		 */
+		double speedup_;
+		double ci_;
+	};
+
+	/**
+	 * A level of the memory hierarchy swept by a PTSWEEP benchmark
+	 */
+	struct Tier {
+		std::string name_;
+		uint64_t wss_;
+		uint64_t ns_op_;
+	};
+
 	/**
 	 * Name of the test that generated this result. Possibly modified by
 	 * pt_set_iter_name().
 	 */
 	std::string name_;
 
+	/**
+	 * Name of the test, as selected by filters, without any name given by
+	 * pt_set_iter_name().
+	 */
+	std::string test_name_;
+
+	/**
+	 * Copied from the test so that results stand on their own once read
+	 * back from a results file.
+	 */
+	bool enabled_ = false;
+	bool bench_ = false;
+	int expect_signal_ = 0;
+	int expect_exit_ = 0;
+
 	/**
 	 * The test received a signal or exited with a bad status code
 	 */
@@ -53,6 +102,17 @@ public:
 	 */
 	bool skipped_ = false;
 
+	/**
+	 * The test wasn't run: this is the result it had last time
+	 */
+	bool cached_ = false;
+
+	/**
+	 * The test was never run (or was stopped partway) because of
+	 * --fail-fast or PTFAILFAST()
+	 */
+	bool notrun_ = false;
+
 	/**
 	 * If the test timed out
 	 */
@@ -83,12 +143,41 @@ public:
 	 */
 	double duration_ = 0.0;
 
+	/**
+	 * What the test used, from its cgroup when run with --cgroup
+	 */
+	uint64_t memory_peak_ = 0;
+	uint64_t cpu_usec_ = 0;
+
+	/**
+	 * Peak resident set size of the forked test, in bytes
+	 */
+	uint64_t max_rss_ = 0;
+
 	/**
 	 * Bench results
 	 */
 	uint64_t bench_iters_ = 0;
 	uint64_t bench_ns_op_ = 0;
 
+	/**
+	 * For benchmarks comparing variants: how many rounds of each ran, and
+	 * what they got.
+	 */
+	uint64_t bench_rounds_ = 0;
+	std::vector<Variant> bench_variants_;
+
+	/**
+	 * For benchmarks run across randomized memory layouts
+	 */
+	uint64_t bench_layouts_ = 0;
+	double bench_layout_sd_ = 0.0;
+
+	/**
+	 * For benchmarks sweeping working set sizes
+	 */
+	std::vector<Tier> bench_tiers_;
+
 	/**
 	 * Captured stdout
 	 */
@@ -99,14 +188,52 @@ public:
 	 */
 	std::string stderr_;
 
+	/**
+	 * Everything printed by running the failed test again under
+	 * --rerun-failed-under
+	 */
+	std::string rerun_;
+
 	/**
 	 * If the test for this result was enabled
 	 */
 	inline bool enabled() const
 	{
-		return this->test_->enabled();
+		return this->enabled_;
 	}
 
+	/**
+	 * If the test passed (or was skipped)
+	 */
+	inline bool passed() const
+	{
+		return this->skipped_
+			   || (!this->failed_ && !this->error_ && !this->timedout_);
+	}
+
+	/**
+	 * The test this is the result of
+	 */
+	inline const sp<const Test> &test() const
+	{
+		return this->test_;
+	}
+
+	/**
+	 * Take everything but the test from another result of the same test
+	 */
+	void replaceWith(Result r);
+
+	/**
+	 * Write this result as a single line of a results file
+	 */
+	void write(std::ostream &os) const;
+
+	/**
+	 * Read a result written by write()
+	 */
+	static Result read(const std::string &line);
+
 	/**
 	 * Reset and get ready to record a new result
 	 */
@@ -139,27 +266,61 @@ class Results
 	size_t enabled_ = 0;
 	size_t skipped_ = 0;
 	size_t passes_ = 0;
+	size_t cached_ = 0;
 	size_t errors_ = 0;
 	size_t failures_ = 0;
 	size_t benches_ = 0;
+	size_t notrun_ = 0;
 	size_t finished_ = 0;
 	size_t total_ = 0;
 	double tests_duration_ = 0.0;
 	time::point start_;
 	time::point end_;
 
+	/**
+	 * Wall time of merged results: that of the longest-running shard
+	 */
+	bool merged_ = false;
+	double merged_wall_ = 0.0;
+
 	sp<Opts> opts_;
 	std::ostream &os_;
 	std::vector<Result> results_;
+	sp<const Cache> cache_;
+
+	/**
+	 * Tests that failed the last time they ran, from --failed-first
+	 */
+	std::set<std::string> failed_last_;
+
+	/**
+	 * Functions of PTFAILFAST tests with a failed iteration
+	 */
+	std::set<std::string> abandoned_;
+
+	/**
+	 * Count the result towards the totals. Returns the character that
+	 * summarizes it.
+	 */
+	char tally(Result r);
+
+	/**
+	 * Show the progress of the run after a result was tallied
+	 */
+	void progress(char summary);
+
+	/**
+	 * How often each test that ran more than once failed, and how long it
+	 * took
+	 */
+	void dumpRepeats() const;
 
 public:
 	/**
 	 * I don't like that this uses a reference, but C++ was fighting me on
 	 * this.
 	 */
-	Results(sp<Opts> opts, std::ostream &os) : opts_(std::move(opts)), os_(os)
-	{
-	}
+	Results(sp<Opts> opts, std::ostream &os);
 
 	/**
 	 * Start the user duration timer
@@ -176,6 +337,47 @@ public:
 	 */
 	void record(const TestEnv &te, Result r);
 
+	/**
+	 * Record that the test won't be run after all
+	 */
+	void cancel(sp<const Test> test);
+
+	/**
+	 * If enough tests have failed that --fail-fast says to stop
+	 */
+	bool failingFast() const;
+
+	/**
+	 * If the test is an iteration of a PTFAILFAST test that already failed
+	 */
+	bool abandoned(const Test &test) const;
+
+	/**
+	 * If every test should run again after the given number of rounds, with
+	 * --count or --until-fail
+	 */
+	bool repeat(size_t rounds) const;
+
+	/**
+	 * If the test failed the last time it ran
+	 */
+	inline bool failedLast(const Test &test) const
+	{
+		return this->failed_last_.count(test.name()) > 0;
+	}
+
+	/**
+	 * Run every test that failed again under the --rerun-failed-under
+	 * command, attaching what it printed to the test's result
+	 */
+	void rerunFailed();
+
+	/**
+	 * If the test passed the last time it ran, with nothing changed since,
+	 * fill in its result from then.
+	 */
+	bool fromCache(const Test &test, Result *r) const;
+
 	/**
 	 * Check if all tests are done running
 	 */
@@ -201,5 +403,33 @@ public:
 	 * Dump a summary of all tests
 	 */
 	void dump();
+
+	/**
+	 * Write all results to a results file
+	 */
+	void write(const std::string &path) const;
+
+	/**
+	 * Write the names of the tests that are still failing, for
+	 * --failed-first
+	 */
+	void writeFailed(const std::string &path) const;
+
+	/**
+	 * Write the given results to a results file
+	 */
+	static void
+	save(const std::string &path, const std::vector<Result> &rs, double wall);
+
+	/**
+	 * Add all results from a results file written by another run
+	 */
+	void merge(const std::string &path);
+
+	/**
+	 * Read all results from a results file
+	 */
+	static std::vector<Result> load(const std::string &path,
+									double *wall = nullptr);
 };
 }
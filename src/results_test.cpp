@@ -7,12 +7,103 @@
  */
 
 #include <iostream>
+#include <stdlib.h>
+#include "main.hpp"
 #include "results.hpp"
 #include "util_test.hpp"
 
 namespace pt
 {
 
+TEST(resultsReadWrite)
+{
+	Result r;
+	std::stringstream ss;
+
+	r.name_ = "test:named";
+	r.test_name_ = "test:1";
+	r.enabled_ = true;
+	r.failed_ = true;
+	r.duration_ = 1.25;
+	r.signal_num_ = 6;
+	r.fail_msg_ = "tabs\tand\nnewlines\\n";
+	r.stdout_ = "=equals=";
+	r.rerun_ = "under\tvalgrind";
+	r.write(ss);
+
+	auto line = ss.str();
+	pt_eq(line.find('\n'), line.size() - 1);
+	line.pop_back();
+
+	auto got = Result::read(line);
+	pt_eq(got.name_, r.name_);
+	pt_eq(got.test_name_, r.test_name_);
+	pt_eq(got.rerun_, r.rerun_);
+	pt(got.enabled_);
+	pt(got.failed_);
+	pt(!got.error_);
+	pt_eq(got.duration_, 1.25);
+	pt_eq(got.signal_num_, 6);
+	pt_eq(got.fail_msg_, r.fail_msg_);
+	pt_eq(got.stdout_, r.stdout_);
+}
+
+TEST(resultsReadWriteBench)
+{
+	Result r;
+	std::stringstream ss;
+
+	r.name_ = "bench";
+	r.bench_ = true;
+	r.bench_rounds_ = 12;
+	r.bench_layouts_ = 4;
+	r.bench_layout_sd_ = 0.5;
+	r.bench_variants_.push_back({ "base", 10.5, 1.0, 0.0 });
+	r.bench_variants_.push_back({ "with,commas\\", 5.25, 2.0, 0.125 });
+	r.bench_tiers_.push_back({ "L1", 16384, 3 });
+	r.bench_tiers_.push_back({ "RAM\t", 1 << 30, 90 });
+	r.write(ss);
+
+	auto line = ss.str();
+	line.pop_back();
+
+	auto got = Result::read(line);
+	pt_eq(got.bench_rounds_, (uint64_t)12);
+	pt_eq(got.bench_layouts_, (uint64_t)4);
+	pt_eq(got.bench_layout_sd_, 0.5);
+
+	pt_eq(got.bench_variants_.size(), (size_t)2);
+	pt_eq(got.bench_variants_[0].name_, "base");
+	pt_eq(got.bench_variants_[0].ns_op_, 10.5);
+	pt_eq(got.bench_variants_[1].name_, r.bench_variants_[1].name_);
+	pt_eq(got.bench_variants_[1].ns_op_, 5.25);
+	pt_eq(got.bench_variants_[1].speedup_, 2.0);
+	pt_eq(got.bench_variants_[1].ci_, 0.125);
+
+	pt_eq(got.bench_tiers_.size(), (size_t)2);
+	pt_eq(got.bench_tiers_[0].name_, "L1");
+	pt_eq(got.bench_tiers_[0].wss_, (uint64_t)16384);
+	pt_eq(got.bench_tiers_[0].ns_op_, (uint64_t)3);
+	pt_eq(got.bench_tiers_[1].name_, r.bench_tiers_[1].name_);
+	pt_eq(got.bench_tiers_[1].wss_, (uint64_t)1 << 30);
+	pt_eq(got.bench_tiers_[1].ns_op_, (uint64_t)90);
+}
+
+TEST(resultsReadUnknownFields)
+{
+	auto r = Result::read("name=a\tfrom_the_future=1");
+	pt_eq(r.name_, "a");
+}
+
+TEST(resultsLoadNotResults)
+{
+	try {
+		Results::load("/dev/null");
+		pt_fail("should have failed");
+	} catch (const Err &) {
+	}
+}
+
 TEST(resultsGetFailure)
 {
 	auto opts = mksp<Opts>();
@@ -23,4 +114,36 @@ TEST(resultsGetFailure)
 	} catch (Err) {
 	}
 }
+
+TEST(_resultsRerunPass)
+{
+}
+
+TEST(_resultsRerunFail)
+{
+	auto under = getenv("PT_RERUN_UNDER");
+	printf("under: %s\n", under != nullptr ? under : "nothing");
+	pt_fail("always fails");
+}
+
+TEST(resultsRerunFailed)
+{
+	std::stringstream out;
+
+	Main m({ MKTEST(_resultsRerunPass), MKTEST(_resultsRerunFail) });
+	auto rslts = m.run(out, { "paratec",
+							  "--rerun-failed-under=env PT_RERUN_UNDER=env {}" });
+
+	pt_eq(rslts.exitCode(), 1);
+	pt_eq(rslts.get("_resultsRerunPass").rerun_, "");
+
+	auto r = rslts.get("_resultsRerunFail");
+	pt_in("under: nothing", r.stdout_);
+	pt_in("under: env", r.rerun_);
+	pt_in("FAIL : _resultsRerunFail", r.rerun_);
+	pt_in("exited with 1", r.rerun_);
+
+	pt_in("rerun", out.str());
+	pt_in("under: env", out.str());
+}
 }
@@ -0,0 +1,97 @@
+/**
+ * @author Andrew Stone <a@stoney.io>
+ * @copyright 2016 Andrew Stone
+ *
+ * This file is part of paratec and is released under the MIT License:
+ * http://opensource.org/licenses/MIT
+ */
+
+#include <algorithm>
+#include <cmath>
+#include "stats.hpp"
+#include "std.hpp"
+
+namespace pt
+{
+namespace stats
+{
+
+/**
+ * Two-tailed t values for 95% confidence, indexed by degrees of freedom - 1
+ */
+static const double kT95[] = {
+	12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+	2.201,  2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+	2.080,  2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042,
+};
+
+static double _t95(size_t df)
+{
+	if (df <= NELS(kT95)) {
+		return kT95[df - 1];
+	}
+
+	if (df <= 60) {
+		return 2.000;
+	}
+
+	if (df <= 120) {
+		return 1.980;
+	}
+
+	return 1.960;
+}
+
+double mean(const std::vector<double> &v)
+{
+	double sum = 0;
+
+	if (v.size() == 0) {
+		return 0;
+	}
+
+	for (auto d : v) {
+		sum += d;
+	}
+
+	return sum / (double)v.size();
+}
+
+double stddev(const std::vector<double> &v)
+{
+	double sum = 0;
+
+	if (v.size() < 2) {
+		return 0;
+	}
+
+	auto m = mean(v);
+	for (auto d : v) {
+		sum += (d - m) * (d - m);
+	}
+
+	return std::sqrt(sum / (double)(v.size() - 1));
+}
+
+double ci95(const std::vector<double> &v)
+{
+	if (v.size() < 2) {
+		return 0;
+	}
+
+	return _t95(v.size() - 1) * stddev(v) / std::sqrt((double)v.size());
+}
+
+double percentile(std::vector<double> v, double p)
+{
+	if (v.size() == 0) {
+		return 0;
+	}
+
+	std::sort(v.begin(), v.end());
+
+	auto rank = (size_t)std::ceil(p / 100 * (double)v.size());
+	return v[std::min(std::max(rank, (size_t)1), v.size()) - 1];
+}
+}
+}
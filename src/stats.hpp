@@ -0,0 +1,39 @@
+/**
+ * @file
+ * @author Andrew Stone <a@stoney.io>
+ * @copyright 2016 Andrew Stone
+ *
+ * This file is part of paratec and is released under the MIT License:
+ * http://opensource.org/licenses/MIT
+ */
+
+#pragma once
+#include <vector>
+
+namespace pt
+{
+namespace stats
+{
+
+/**
+ * Arithmetic mean; 0 if empty
+ */
+double mean(const std::vector<double> &v);
+
+/**
+ * Sample standard deviation; 0 with fewer than 2 values
+ */
+double stddev(const std::vector<double> &v);
+
+/**
+ * Half-width of the 95% confidence interval of the mean, using Student's t
+ * distribution.
+ */
+double ci95(const std::vector<double> &v);
+
+/**
+ * The p-th (0-100) percentile, by nearest rank; 0 if empty
+ */
+double percentile(std::vector<double> v, double p);
+}
+}
@@ -0,0 +1,47 @@
+/**
+ * @author Andrew Stone <a@stoney.io>
+ * @copyright 2016 Andrew Stone
+ *
+ * This file is part of paratec and is released under the MIT License:
+ * http://opensource.org/licenses/MIT
+ */
+
+#include <cmath>
+#include "stats.hpp"
+#include "util_test.hpp"
+
+namespace pt
+{
+namespace stats
+{
+
+TEST(statsEmpty)
+{
+	std::vector<double> v;
+
+	pt_eq(mean(v), 0.0);
+	pt_eq(stddev(v), 0.0);
+	pt_eq(ci95(v), 0.0);
+	pt_eq(percentile(v, 50), 0.0);
+}
+
+TEST(statsBasic)
+{
+	std::vector<double> v({ 2, 4, 4, 4, 5, 5, 7, 9 });
+
+	pt_eq(mean(v), 5.0);
+	pt_lt(std::fabs(stddev(v) - 2.138), 0.001);
+	pt_lt(std::fabs(ci95(v) - 1.787), 0.001);
+}
+
+TEST(statsPercentile)
+{
+	std::vector<double> v({ 9, 2, 7, 4, 5, 4, 5, 4 });
+
+	pt_eq(percentile(v, 0), 2.0);
+	pt_eq(percentile(v, 50), 4.0);
+	pt_eq(percentile(v, 90), 9.0);
+	pt_eq(percentile(v, 100), 9.0);
+}
+}
+}
@@ -6,46 +6,99 @@
  * http://opensource.org/licenses/MIT
  */
 
+#include <algorithm>
+#include "err.hpp"
 #include "test.hpp"
 
 namespace pt
 {
 
-sp<const Test> Test::bindTo(int64_t i, sp<const Opts> opts) const
+/**
+ * Split a comma-separated list given to a test modifier
+ */
+static std::vector<std::string> _split(const char *list)
 {
-	void *vitem = this->vec_ == nullptr ? nullptr : ((char *)this->vec_)
-														+ (i * this->vecisize_);
-	auto test = mksp<Test>(static_cast<const _paratec &>(*this), i, vitem);
+	std::string item;
+	std::vector<std::string> items;
+
+	for (const char *c = list;; c++) {
+		if (*c == ',' || *c == '\0') {
+			items.push_back(std::move(item));
+			item.clear();
+		} else if (*c != ' ') {
+			item += *c;
+		}
 
-	test->opts_ = std::move(opts);
-	const auto &filts = test->opts_->filter_.filts_;
+		if (*c == '\0') {
+			break;
+		}
+	}
 
-	// By default, not disabled. Once matched in a negative filter, however,
-	// can't be re-enabled.
-	bool disable = false;
+	return items;
+}
 
-	// If there are no filters, everything is enabled.
-	bool enable = filts.size() == 0;
+Test::Test(const _paratec_desc &d) : _paratec(), name_(d.name_)
+{
+	this->fn_name_ = d.fn_name_;
+	this->_paratec::name_ = d.name_;
+	this->fn_ = d.fn_;
+	d.init_(this);
 
-	// Every test becomes disabled by default if a single positive filter is
-	// given. Only things that pass the filter run.
-	bool hasPosFilt = false;
+	if (this->cmp_ != nullptr) {
+		this->variants_ = _split(this->cmp_);
 
-	for (const auto &f : filts) {
-		bool matches = strstr(test->name(), f.c_str()) == test->name();
+		// Variants are passed as _i, which a range needs for itself
+		if (this->ranged_) {
+			Err(-1, "%s: PTCMP() can't be used with PTI()", d.name_);
+		}
 
-		hasPosFilt |= !f.neg_;
-		if (matches) {
-			disable |= f.neg_;
-			enable |= !f.neg_;
+		if (this->variants_.size() < 2) {
+			Err(-1, "%s: PTCMP() needs at least 2 variants, got `%s`",
+				d.name_, this->cmp_);
 		}
 	}
 
-	if (hasPosFilt) {
-		test->enabled_ = !disable && enable;
-	} else {
-		test->enabled_ = !disable;
+	if (this->inputs_ != nullptr) {
+		this->inputs_list_ = _split(this->inputs_);
+	}
+
+	if (this->nres_ > PT_MAX_RES) {
+		Err(-1, "%s: a test may use at most %d resources, got %d", d.name_,
+			PT_MAX_RES, this->nres_);
+	}
+
+	// Naming a resource twice only holds it once
+	for (int i = 0; i < this->nres_; i++) {
+		auto count = (uint)std::max(this->res_count_[i], 1);
+		auto it = this->resources_.emplace(this->res_[i], count).first;
+		it->second = std::min(it->second, count);
 	}
+}
+
+Test::Test(std::string name, sp<const Remote> remote, double timeout)
+	: _paratec(), name_(std::move(name)), remote_(std::move(remote))
+{
+	this->fn_name_ = this->remote_->name_.c_str();
+	this->_paratec::name_ = this->remote_->name_.c_str();
+	this->timeout_ = timeout;
+}
+
+sp<const Test> Test::bindTo(int64_t i, sp<const Opts> opts) const
+{
+	void *vitem = this->vec_ == nullptr ? nullptr : ((char *)this->vec_)
+														+ (i * this->vecisize_);
+	auto test = mksp<Test>(*this);
+
+	test->i_ = i;
+	test->vitem_ = vitem;
+
+	if (this->isRanged()) {
+		test->name_ += ':';
+		test->name_ += std::to_string(i);
+	}
+
+	test->opts_ = std::move(opts);
+	test->enabled_ = test->opts_->filter_.get().selects(test->name());
 
 	if (this->isBenchmark()) {
 		test->enabled_ &= test->opts_->bench_.get();
@@ -54,24 +107,66 @@ sp<const Test> Test::bindTo(int64_t i, sp<const Opts> opts) const
 	return test;
 }
 
-time::duration Test::bench(uint32_t n) const
+sp<const Test> Test::runIn(sp<const Remote> remote) const
 {
-	time::point start;
-	time::point end;
+	auto test = mksp<Test>(*this);
+
+	// Give the binary a second to start up and write its results
+	test->timeout_ = this->timeout() + 1.0;
+	test->remote_ = std::move(remote);
+	test->setup_ = nullptr;
+	test->teardown_ = nullptr;
+	test->cleanup_ = nullptr;
+
+	return test;
+}
+
+time::duration Test::bench(uint32_t n,
+						   const time::BenchTimer &timer,
+						   Profiler *prof,
+						   size_t variant) const
+{
+	auto i = this->variants_.size() > 0 ? (int64_t)variant : this->i_;
+	uint64_t start;
+	uint64_t end;
 
 	if (this->setup_ != NULL) {
 		this->setup_();
 	}
 
-	start = time::now();
-	this->fn_(this->i_, n, this->vitem_);
-	end = time::now();
+	if (prof != nullptr) {
+		prof->start();
+	}
+
+	start = timer.start();
+	this->fn_(i, n, this->vitem_);
+	end = timer.stop();
+
+	if (prof != nullptr) {
+		prof->stop();
+	}
 
 	if (this->teardown_ != NULL) {
 		this->teardown_();
 	}
 
-	return end - start;
+	return timer.elapsed(start, end);
+}
+
+void *Test::benchSetup() const
+{
+	if (this->bench_setup_ != nullptr) {
+		return this->bench_setup_();
+	}
+
+	return nullptr;
+}
+
+void Test::benchTeardown(void *state) const
+{
+	if (this->bench_teardown_ != nullptr) {
+		this->bench_teardown_(state);
+	}
 }
 
 void Test::run() const
@@ -80,6 +175,10 @@ void Test::run() const
 		this->setup_();
 	}
 
+	if (this->remote_ != nullptr) {
+		this->remote_->exec(*this->opts_);
+	}
+
 	this->fn_(this->i_, 0, this->vitem_);
 
 	if (this->teardown_ != NULL) {
@@ -8,9 +8,14 @@
  */
 
 #pragma once
+#include <map>
+#include <string>
 #include <tuple>
+#include <vector>
 #include "opts.hpp"
 #include "paratec.h"
+#include "profile.hpp"
+#include "remote.hpp"
 #include "std.hpp"
 #include "test_env.hpp"
 #include "time.hpp"
@@ -35,21 +40,36 @@ class Test : public _paratec
 
 	bool enabled_ = true;
 
-public:
-	Test(const _paratec &p) : _paratec(p), name_(p.name_)
-	{
-	}
+	/**
+	 * Names of the variants given to PTCMP
+	 */
+	std::vector<std::string> variants_;
 
-	Test(const _paratec &p, int64_t i, void *vitem) : Test(p)
-	{
-		this->i_ = i;
-		this->vitem_ = vitem;
+	/**
+	 * Paths given to PTINPUT
+	 */
+	std::vector<std::string> inputs_list_;
 
-		if (this->isRanged()) {
-			this->name_ += ':';
-			this->name_ += std::to_string(i);
-		}
-	}
+	/**
+	 * Resources given to PTRES, and how many tests may hold each
+	 */
+	std::map<std::string, uint> resources_;
+
+	/**
+	 * For tests that live in other binaries
+	 */
+	sp<const Remote> remote_;
+
+public:
+	/**
+	 * Create a test from its descriptor, running the descriptor's modifiers.
+	 */
+	Test(const _paratec_desc &d);
+
+	/**
+	 * Create a test that runs a test in another binary
+	 */
+	Test(std::string name, sp<const Remote> remote, double timeout);
 
 	/**
 	 * Create a new test that runs at the given index, bound to the given
@@ -57,6 +77,12 @@ public:
 	 */
 	sp<const Test> bindTo(int64_t i, sp<const Opts> opts) const;
 
+	/**
+	 * Create a new test that runs this bound test in another process of the
+	 * given binary, which does its own setup and teardown.
+	 */
+	sp<const Test> runIn(sp<const Remote> remote) const;
+
 	/**
 	 * Human-friendly test name, with index if an iterated test.
 	 */
@@ -90,6 +116,27 @@ public:
 								  : this->opts_->timeout_.get();
 	}
 
+	/**
+	 * Limits on the test's cgroup; 0 if unlimited
+	 */
+	inline uint64_t memoryMax() const
+	{
+		return this->memory_max_ > 0 ? this->memory_max_
+									 : this->opts_->memory_max_.get();
+	}
+
+	inline double cpuMax() const
+	{
+		return this->cpu_max_ > 0 ? this->cpu_max_
+								  : this->opts_->cpu_max_.get();
+	}
+
+	inline uint64_t pidsMax() const
+	{
+		return this->pids_max_ > 0 ? this->pids_max_
+								   : this->opts_->pids_max_.get();
+	}
+
 	/**
 	 * Check if this test operates on a range
 	 */
@@ -106,6 +153,48 @@ public:
 		return this->bench_;
 	}
 
+	/**
+	 * Names of the variants this benchmark compares; empty if it doesn't
+	 * compare anything.
+	 */
+	inline const std::vector<std::string> &variants() const
+	{
+		return this->variants_;
+	}
+
+	/**
+	 * Resources the test holds while it runs
+	 */
+	inline const std::map<std::string, uint> &resources() const
+	{
+		return this->resources_;
+	}
+
+	/**
+	 * Files the test reads
+	 */
+	inline const std::vector<std::string> &inputs() const
+	{
+		return this->inputs_list_;
+	}
+
+	/**
+	 * If this benchmark is run at each level of the memory hierarchy
+	 */
+	inline bool sweeps() const
+	{
+		return this->sweep_;
+	}
+
+	/**
+	 * The test in another binary that this runs; null if the test is in
+	 * this binary.
+	 */
+	inline const Remote *remote() const
+	{
+		return this->remote_.get();
+	}
+
 	/**
 	 * Range of the test.
 	 */
@@ -116,9 +205,24 @@ public:
 	}
 
 	/**
-	 * Run a benchmark
+	 * Run a benchmark, timed with the given timer. If given a profiler, only
+	 * the timed region is sampled. For benchmarks that compare variants,
+	 * `variant` is the index of the variant to run.
+	 */
+	time::duration bench(uint32_t n,
+						 const time::BenchTimer &timer,
+						 Profiler *prof,
+						 size_t variant) const;
+
+	/**
+	 * Prepare the state shared by all rounds of a benchmark
+	 */
+	void *benchSetup() const;
+
+	/**
+	 * Tear down the state returned from benchSetup()
 	 */
-	time::duration bench(uint32_t n) const;
+	void benchTeardown(void *state) const;
 
 	/**
 	 * Run the test. If this is a benchmark, run the given number of iters.
@@ -19,6 +19,9 @@ void TestEnv::reset(uint id, const char *test_name, const char *func_name)
 	this->skipped_ = false;
 	this->bench_iters_ = 0;
 	this->bench_ns_op_ = 0;
+	this->bench_rounds_ = 0;
+	this->bench_tiers_ = 0;
+	this->bench_layouts_ = 0;
 	this->iter_name_[0] = '\0';
 	this->last_mark_[0] = '\0';
 	this->fail_msg_[0] = '\0';
@@ -20,6 +20,8 @@ namespace pt
  */
 struct TestEnv {
 	static constexpr int kSize = 2048;
+	static constexpr int kMaxVariants = 16;
+	static constexpr int kMaxTiers = 4;
 
 	/**
 	 * The id of the job that this test is running in
@@ -42,6 +44,31 @@ struct TestEnv {
 	uint64_t bench_iters_;
 	uint64_t bench_ns_op_;
 
+	/**
+	 * Results of compared variants: mean ns/op of each, and its speedup
+	 * (with 95% confidence interval) relative to the first variant.
+	 */
+	uint64_t bench_rounds_;
+	double bench_var_ns_op_[kMaxVariants];
+	double bench_var_speedup_[kMaxVariants];
+	double bench_var_ci_[kMaxVariants];
+
+	/**
+	 * For benchmarks run across randomized memory layouts: how many, and
+	 * the standard deviation of ns/op between them.
+	 */
+	uint64_t bench_layouts_;
+	double bench_layout_sd_;
+
+	/**
+	 * Results of a working set sweep: the ns/op at each level of the memory
+	 * hierarchy.
+	 */
+	uint64_t bench_tiers_;
+	char bench_tier_name_[kMaxTiers][8];
+	uint64_t bench_tier_wss_[kMaxTiers];
+	uint64_t bench_tier_ns_op_[kMaxTiers];
+
 	/**
 	 * Human-readable and print-friendly test name
 	 */
@@ -6,6 +6,7 @@
  * http://opensource.org/licenses/MIT
  */
 
+#include "err.hpp"
 #include "main.hpp"
 #include "test.hpp"
 #include "util_test.hpp"
@@ -65,6 +66,99 @@ TESTV(testFilter, _testFilter)
 	opts->parse(_t->args_);
 	pt(test->bindTo(0, opts)->enabled() == _t->enabled_,
 	   "expected test to be %s", _t->enabled_ ? "enabled" : "disabled");
+
+	// Anything enabled must make it past the pre-filter
+	if (_t->enabled_) {
+		pt(opts->filter_.get().mayMatch(test->name()));
+	}
+}
+
+TEST(_modified, PTTIME(3.5), PTI(2, 4))
+{
+}
+
+TEST(testDescriptor)
+{
+	auto opts = mksp<Opts>();
+	auto test = MKTEST(_modified);
+
+	pt_eq(test->name(), "_modified");
+	pt_eq(test->funcName(), "__paratec_fn__modified");
+	pt(test->isRanged());
+
+	auto bound = test->bindTo(3, opts);
+	pt_eq(bound->name(), "_modified:3");
+	pt_eq(bound->timeout(), 3.5);
+}
+
+/**
+ * Invalid tests can't be registered like the others: every run of this binary
+ * would refuse to start.
+ */
+static void _cmpInitOne(struct _paratec *p)
+{
+	PTCMP("only");
+}
+
+static void _cmpInitRanged(struct _paratec *p)
+{
+	PTCMP("a, b"), PTI(0, 2);
+}
+
+TEST(testCmpOneVariant)
+{
+	const _paratec_desc d = { "_cmpOne", "_cmpOne", nullptr, _cmpInitOne };
+
+	try {
+		Test t(d);
+		pt_fail("a single variant was accepted");
+	} catch (Err &e) {
+		pt_in("_cmpOne: PTCMP() needs at least 2 variants", e.what());
+	}
+}
+
+TEST(testCmpRanged)
+{
+	const _paratec_desc d = { "_cmpRanged", "_cmpRanged", nullptr,
+							  _cmpInitRanged };
+
+	try {
+		Test t(d);
+		pt_fail("PTCMP() was accepted with PTI()");
+	} catch (Err &e) {
+		pt_in("_cmpRanged: PTCMP() can't be used with PTI()", e.what());
+	}
+}
+
+static void _resInitTooMany(struct _paratec *p)
+{
+	PTRES("a", 1), PTRES("b", 1), PTRES("c", 1), PTRES("d", 1),
+		PTRES("e", 1);
+}
+
+TEST(testResTooMany)
+{
+	const _paratec_desc d = { "_resMany", "_resMany", nullptr,
+							  _resInitTooMany };
+
+	try {
+		Test t(d);
+		pt_fail("too many resources were accepted");
+	} catch (Err &e) {
+		pt_in("_resMany: a test may use at most 4 resources, got 5", e.what());
+	}
+}
+
+TEST(_resTwice, PTRES("a", 3), PTRES("b", 1), PTRES("a", 2))
+{
+}
+
+TEST(testResources)
+{
+	auto test = MKTEST(_resTwice);
+	std::map<std::string, uint> expect{ { "a", 2 }, { "b", 1 } };
+
+	pt(test->resources() == expect);
 }
 
 TESTV(testVec, _testFilter)
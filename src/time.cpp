@@ -7,8 +7,14 @@
  * http://opensource.org/licenses/MIT
  */
 
+#include <algorithm>
+#include <thread>
 #include "time.hpp"
 
+#ifdef PT_TSC
+#include <cpuid.h>
+#endif
+
 namespace pt
 {
 namespace time
@@ -35,5 +41,67 @@ duration toDuration(double secs)
 	return std::chrono::duration_cast<duration>(
 		std::chrono::duration<double, std::ratio<1, 1>>(secs));
 }
+
+bool tscInvariant()
+{
+#ifdef PT_TSC
+	unsigned int eax, ebx, ecx, edx;
+
+	if (__get_cpuid(0x80000000, &eax, &ebx, &ecx, &edx) == 0
+		|| eax < 0x80000007) {
+		return false;
+	}
+
+	__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx);
+	return (edx & (1 << 8)) != 0;
+#else
+	return false;
+#endif
+}
+
+BenchTimer::BenchTimer(bool tsc)
+{
+	this->tsc_ = tsc && tscInvariant();
+	this->calibrate();
+}
+
+void BenchTimer::calibrate()
+{
+	static constexpr int kOverheadSamples = 1000;
+	static constexpr auto kCalibrateFor = std::chrono::milliseconds(10);
+
+	int i;
+
+	if (this->tsc_) {
+		auto clock_start = this->clock();
+		auto tsc_start = this->start();
+
+		std::this_thread::sleep_for(kCalibrateFor);
+
+		auto tsc_end = this->stop();
+		auto clock_end = this->clock();
+
+		this->ns_per_tick_
+			= (double)(clock_end - clock_start) / (double)(tsc_end - tsc_start);
+	}
+
+	// The smallest observed gap is the cost of the timer itself; anything
+	// larger had something else (an interrupt, a migration) get in the way.
+	this->overhead_ = UINT64_MAX;
+	for (i = 0; i < kOverheadSamples; i++) {
+		auto s = this->start();
+		auto e = this->stop();
+		this->overhead_ = std::min(this->overhead_, e - s);
+	}
+}
+
+duration BenchTimer::elapsed(uint64_t start, uint64_t stop) const
+{
+	uint64_t ticks = stop - start;
+	ticks = ticks > this->overhead_ ? ticks - this->overhead_ : 0;
+
+	return std::chrono::duration_cast<duration>(std::chrono::nanoseconds(
+		(int64_t)((double)ticks * this->ns_per_tick_)));
+}
 }
 }
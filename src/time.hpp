@@ -9,6 +9,13 @@
 
 #pragma once
 #include <chrono>
+#include <stdint.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define PT_TSC
+#include <x86intrin.h>
+#endif
 
 namespace pt
 {
@@ -37,5 +44,94 @@ double toSeconds(duration d);
  * Convert seconds to a duration
  */
 duration toDuration(double secs);
+
+/**
+ * If this CPU has a TSC that ticks at a constant rate, no matter the
+ * frequency or power state of the core.
+ */
+bool tscInvariant();
+
+/**
+ * Times benchmarks. Readings are taken in ticks, which only mean something
+ * to the timer that took them; use elapsed() to turn them into durations.
+ */
+class BenchTimer
+{
+	bool tsc_ = false;
+	double ns_per_tick_ = 1.0;
+
+	/**
+	 * Ticks between a back-to-back start() and stop()
+	 */
+	uint64_t overhead_ = 0;
+
+	void calibrate();
+
+public:
+	/**
+	 * If `tsc` and the TSC is invariant, the TSC is used; otherwise,
+	 * clock_gettime() is.
+	 */
+	BenchTimer(bool tsc);
+
+	inline bool tsc() const
+	{
+		return this->tsc_;
+	}
+
+	inline uint64_t overhead() const
+	{
+		return this->overhead_;
+	}
+
+	/**
+	 * Take a reading before the timed region. Nothing from the timed region
+	 * can be executed before this.
+	 */
+	inline uint64_t start() const
+	{
+#ifdef PT_TSC
+		if (this->tsc_) {
+			_mm_lfence();
+			uint64_t t = __rdtsc();
+			_mm_lfence();
+			return t;
+		}
+#endif
+
+		return this->clock();
+	}
+
+	/**
+	 * Take a reading after the timed region. rdtscp waits for everything
+	 * before it to finish, and the fence keeps anything after from starting
+	 * early.
+	 */
+	inline uint64_t stop() const
+	{
+#ifdef PT_TSC
+		if (this->tsc_) {
+			unsigned int aux;
+			uint64_t t = __rdtscp(&aux);
+			_mm_lfence();
+			return t;
+		}
+#endif
+
+		return this->clock();
+	}
+
+	inline uint64_t clock() const
+	{
+		struct timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+	}
+
+	/**
+	 * Time between two readings, minus the overhead of taking them
+	 */
+	duration elapsed(uint64_t start, uint64_t stop) const;
+};
 }
 }
@@ -0,0 +1,57 @@
+/**
+ * @author Andrew Stone <a@stoney.io>
+ * @copyright 2016 Andrew Stone
+ *
+ * This file is part of paratec and is released under the MIT License:
+ * http://opensource.org/licenses/MIT
+ */
+
+#include <thread>
+#include "time.hpp"
+#include "util_test.hpp"
+
+namespace pt
+{
+namespace time
+{
+
+static void _checkTimer(const BenchTimer &t)
+{
+	auto start = t.start();
+	std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	auto end = t.stop();
+
+	auto ns = toNanoSeconds(t.elapsed(start, end));
+	pt_ge(ns, (uint64_t)5000000);
+	pt_lt(ns, (uint64_t)1000000000);
+
+	// Back-to-back readings are all overhead
+	start = t.start();
+	end = t.stop();
+	pt_lt(toNanoSeconds(t.elapsed(start, end)), (uint64_t)100000);
+}
+
+TEST(timeBenchClock)
+{
+	BenchTimer t(false);
+
+	pt(!t.tsc());
+	_checkTimer(t);
+}
+
+TEST(timeBenchTSC)
+{
+	BenchTimer t(true);
+
+	pt_eq(t.tsc(), tscInvariant());
+	_checkTimer(t);
+}
+
+TEST(timeBenchElapsedUnderflow)
+{
+	BenchTimer t(false);
+
+	pt_eq(toNanoSeconds(t.elapsed(100, 100)), (uint64_t)0);
+}
+}
+}
@@ -6,6 +6,7 @@
  * http://opensource.org/licenses/MIT
  */
 
+#include <inttypes.h>
 #include "err.hpp"
 #include "util.hpp"
 
@@ -38,4 +39,26 @@ void format(std::ostream &os, const char *format, ...)
 		os << bbuff;
 	}
 }
+
+std::string humanBytes(uint64_t bytes)
+{
+	static const char *kSuffixes = "BKMGT";
+
+	char buff[32];
+	double v = (double)bytes;
+	const char *suffix = kSuffixes;
+
+	while (v >= 1024 && suffix[1] != '\0') {
+		v /= 1024;
+		suffix++;
+	}
+
+	if (v == (double)(uint64_t)v) {
+		snprintf(buff, sizeof(buff), "%" PRIu64 "%c", (uint64_t)v, *suffix);
+	} else {
+		snprintf(buff, sizeof(buff), "%.1f%c", v, *suffix);
+	}
+
+	return buff;
+}
 }
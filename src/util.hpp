@@ -19,6 +19,11 @@ namespace pt
 PT_PRINTF(2, 3)
 void format(std::ostream &os, const char *format, ...);
 
+/**
+ * Format a byte count with a binary suffix: 32K, 1.5M, etc.
+ */
+std::string humanBytes(uint64_t bytes);
+
 /**
  * Call a function on scope exit.
  */
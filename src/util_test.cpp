@@ -32,6 +32,15 @@ TEST(utilFormat)
 	pt_eq(strlen(buff), out.str().size());
 }
 
+TEST(utilHumanBytes)
+{
+	pt_eq(humanBytes(0), "0B");
+	pt_eq(humanBytes(512), "512B");
+	pt_eq(humanBytes(32 * 1024), "32K");
+	pt_eq(humanBytes(1536 * 1024), "1.5M");
+	pt_eq(humanBytes(16ULL << 30), "16G");
+}
+
 TEST(sharedMem)
 {
 	SharedMem<std::atomic_bool> m0;
@@ -0,0 +1,32 @@
+/**
+ * Tests that are only ever run by being loaded with --load.
+ *
+ * @author Andrew Stone <a@stoney.io>
+ * @copyright 2016 Andrew Stone
+ *
+ * This file is part of paratec and is released under the MIT License:
+ * http://opensource.org/licenses/MIT
+ */
+
+#include "paratec.h"
+
+static int _loadVec[] = { 1, 2, 3 };
+
+PARATEC(_loadPass)
+{
+	pt_eq(1, 1);
+}
+
+PARATEC(_loadFail)
+{
+	pt_fail("failed in a loaded suite");
+}
+
+PARATECV(_loadVec, _loadVec)
+{
+	pt_gt(*_t, 0);
+}
+
+PARATEC(_loadTimeout, PTTIME(3))
+{
+}